@@ -1,21 +1,67 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 #define ARQ_CLIENTES "clientes.dat"
 #define ARQ_FUNCIONARIOS "funcionarios.dat"
 #define ARQ_QUARTOS "quartos.dat"
 #define ARQ_ESTADIAS "estadias.dat"
+#define ARQ_FIDELIDADE "fidelidade.dat"
+#define ARQ_DIARIO "diario.jnl"
+#define ARQ_TRI_CLIENTES "clientes.tri"
+#define ARQ_TRI_FUNCIONARIOS "funcionarios.tri"
+#define ARQ_PARTICOES "estadias.arq"          // meses com estadias arquivadas
+#define ARQ_MES_ARQUIVADO "estadias-%06d.arq" // AAAAMM
+#define ARQ_ALTERACOES "alteracoes.log"        // log de alteracoes para replicas
+#define ARQ_SEGUIDOR "seguidor.pos"            // replica: ate onde o log ja foi aplicado
+
+#define FORMATO_VERSAO 1
+
+/* formato em disco: cada .dat comeca com um CabecalhoArquivo de 32 bytes e
+   depois vem os registros, todos do mesmo tamanho. as structs sao
+   empacotadas (sem bytes de alinhamento) e usam inteiros de largura fixa,
+   entao o registro gravado e exatamente a struct em memoria. */
+#pragma pack(push, 1)
 
 typedef struct {
-    int codigo;
+    char magia[4];         // "HDGC", "HDGF", "HDGQ", "HDGE", "HDGP" ou "HDGM"
+    uint16_t versao;       // FORMATO_VERSAO
+    uint16_t tamRegistro;  // sizeof do registro, confere na abertura
+    uint32_t quantidade;   // registros gravados depois do cabecalho
+    int32_t proximoCodigo; // proximo codigo automatico (0 = ainda nao gravado)
+    uint32_t alteracoes;   // baixas gravadas (estadias), para os outros terminais
+    uint32_t geracao;      // compactacoes (estadias): as posicoes dos registros mudaram
+    uint8_t reservado[8];  // completa 32 bytes
+} CabecalhoArquivo;
+
+typedef struct {
+    int32_t codigo;
     char nome[80];
     char endereco[120];
     char telefone[20];
 } Cliente;
 
 typedef struct {
-    int codigo;
+    int32_t codigo;
     char nome[80];
     char telefone[20];
     char cargo[30];
@@ -23,23 +69,51 @@ typedef struct {
 } Funcionario;
 
 typedef struct {
-    int numero;
-    int qtdHospedes;
+    int32_t numero;
+    int16_t qtdHospedes;
     float valorDiaria;
-    int ocupado;
+    uint8_t ocupado;
 } Quarto;
 
+// dias desde 01/01/1970
+typedef int32_t Data;
+
 typedef struct {
-    int codigo;
-    // Tamanho 9 para 8 dgitos (AAAAMMDD) + \0
-    char dataEntrada[9];
-    char dataSaida[9];
-    int qtdDiarias;
-    int codCliente;
-    int numeroQuarto;
-    int ativo;
+    int32_t codigo;
+    Data dataEntrada; // numero do dia, ver DIA_CIVIL
+    Data dataSaida;
+    int16_t qtdDiarias;
+    int32_t codCliente;
+    int32_t numeroQuarto;
+    uint8_t ativo;
 } Estadia;
 
+// total por cliente, mantido a cada cadastro/baixa de estadia
+typedef struct {
+    int32_t codCliente;
+    int32_t totalDiarias;       // todas as estadias, como calcular_pontos sempre somou
+    int32_t diariasFinalizadas; // so as que ja tiveram baixa
+    int32_t estadias;
+} Fidelidade;
+
+// mes com estadias arquivadas (estadias.arq)
+typedef struct {
+    int32_t mes; // AAAAMM
+} ParticaoEstadias;
+
+// bloco de um arquivo mensal: cabecalho e depois tam bytes comprimidos
+typedef struct {
+    char magia[4];    // "HDGB"
+    uint32_t geracao; // compactacao que gravou; so vale se estadias.dat ja tem essa geracao
+    uint32_t qtd;     // estadias no bloco
+    uint32_t tam;     // bytes depois do cabecalho
+    uint32_t soma;    // FNV-1a dos bytes
+} CabecalhoBloco;
+
+#pragma pack(pop)
+
+_Static_assert(sizeof(CabecalhoArquivo) == 32, "cabecalho deve ter 32 bytes");
+
 //funcoes utilitarias
 
 // Lida com newline de fgets
@@ -54,9 +128,58 @@ void limpar_buffer_scanf() {
     while ((c = getchar()) != '\n' && c != EOF) { }
 }
 
-// NOVO: L dia, ms e ano separadamente, valida, e formata em AAAAMMDD
+/* datas sao guardadas como numero do dia (dias desde 01/01/1970 no
+   calendario gregoriano, algoritmo days_from_civil de H. Hinnant).
+   DIA_CIVIL e uma expressao constante: DIA_CIVIL(2025, 1, 1) ja vira
+   numero na compilacao. */
+#define DC_ANO(a, m) ((a) - ((m) <= 2))
+#define DC_ERA(a, m) ((DC_ANO(a, m) >= 0 ? DC_ANO(a, m) : DC_ANO(a, m) - 399) / 400)
+#define DC_ANO_DA_ERA(a, m) (DC_ANO(a, m) - DC_ERA(a, m) * 400)
+#define DC_DIA_DO_ANO(m, d) ((153 * ((m) > 2 ? (m) - 3 : (m) + 9) + 2) / 5 + (d) - 1)
+#define DIA_CIVIL(a, m, d) ((Data)(DC_ERA(a, m) * 146097 + DC_ANO_DA_ERA(a, m) * 365 + \
+    DC_ANO_DA_ERA(a, m) / 4 - DC_ANO_DA_ERA(a, m) / 100 + DC_DIA_DO_ANO(m, d) - 719468))
+
+_Static_assert(DIA_CIVIL(1970, 1, 1) == 0, "DIA_CIVIL: epoca errada");
+_Static_assert(DIA_CIVIL(2000, 3, 1) == 11017, "DIA_CIVIL: ano bissexto errado");
+
+Data data_de_civil(int a, int m, int d) {
+    return DIA_CIVIL(a, m, d);
+}
+
+// caminho inverso (civil_from_days): numero do dia -> ano, mes, dia
+void civil_de_data(Data data, int *a, int *m, int *d) {
+    long z = (long)data + 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long dia_era = z - era * 146097;
+    long ano_era = (dia_era - dia_era / 1460 + dia_era / 36524 - dia_era / 146096) / 365;
+    long dia_ano = dia_era - (365 * ano_era + ano_era / 4 - ano_era / 100);
+    long mp = (5 * dia_ano + 2) / 153;
+    *d = (int)(dia_ano - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *a = (int)(ano_era + era * 400 + (*m <= 2));
+}
+
+// escreve a data como AAAAMMDD (mesmo formato que era gravado antes)
+void formatar_data(Data data, char destino[9]) {
+    int a, m, d;
+    civil_de_data(data, &a, &m, &d);
+    snprintf(destino, 9, "%04d%02d%02d", a, m, d);
+}
+
+// converte dia, mes e ano para numero do dia. retorna 0 se a data nao existe
+int validar_data(int d, int m, int a, Data *destino) {
+    // a conversao de volta so bate se o dia existe no mes (31/04, 29/02 etc)
+    int ca = 0, cm = 0, cd = 0;
+    if (a >= 2024 && m >= 1 && m <= 12 && d >= 1 && d <= 31)
+        civil_de_data(data_de_civil(a, m, d), &ca, &cm, &cd);
+    if (ca != a || cm != m || cd != d) return 0;
+    *destino = data_de_civil(a, m, d);
+    return 1;
+}
+
+// L dia, ms e ano separadamente, valida e converte para numero do dia
 // Retorna 1 em sucesso, 0 em falha.
-int ler_e_formatar_data(const char *prompt, char *destino_AAAAMMDD) {
+int ler_data(const char *prompt, Data *destino) {
     int d, m, a;
     printf("%s (Dia Mes Ano): ", prompt);
     // L dia, ms, ano
@@ -67,418 +190,4134 @@ int ler_e_formatar_data(const char *prompt, char *destino_AAAAMMDD) {
     }
     limpar_buffer_scanf(); // Limpa o buffer aps o scanf
 
-    // Validao de formato simplificada
-    if (a < 2024 || m < 1 || m > 12 || d < 1 || d > 31) {
-        printf("Data invalida. (Ano deve ser >= 2024, Mes 1-12, Dia 1-31).\n");
+    if (!validar_data(d, m, a, destino)) {
+        printf("Data invalida. (Ano deve ser >= 2024, Mes 1-12, Dia existente no mes).\n");
         return 0;
     }
-
-    // Formata para o formato AAAAMMDD para uso na struct e comparaes
-    sprintf(destino_AAAAMMDD, "%04d%02d%02d", a, m, d);
     return 1;
 }
 
-
-/* compara datas no formato "AAAAMMDD" lexicograficamente:
-   retorna <0 se a < b, 0 se iguais, >0 se a > b */
-int cmp_date(const char *a, const char *b) {
-    return strcmp(a, b);
+// retorna <0 se a < b, 0 se iguais, >0 se a > b
+int cmp_date(Data a, Data b) {
+    return (a > b) - (a < b);
 }
 
-/* calcula diferenca de dias simplificada contando dias inteiros:
-   assume formato AAAAMMDD valido e que b > a
-*/
-int diff_days_simple(const char *entrada, const char *saida) {
-    int ay, am, ad, by, bm, bd;
-    // Lendo AAAAMMDD (4 digitos ano, 2 mes, 2 dia)
-    if (sscanf(entrada, "%4d%2d%2d", &ay, &am, &ad) != 3) return -1;
-    if (sscanf(saida, "%4d%2d%2d", &by, &bm, &bd) != 3) return -1;
-    int dias = (by - ay) * 365 + (bm - am) * 30 + (bd - ad);
+// numero de diarias entre entrada e saida, -1 se a saida nao for depois da entrada
+int diff_days(Data entrada, Data saida) {
+    int dias = saida - entrada;
     if (dias <= 0) return -1;
     return dias;
 }
 
 /* verifica se dois intervalos [a1,a2) e [b1,b2) se sobrepoem.
-   usamos comparacao lexicografica pois as datas estao em AAAAMMDD.
    retorna 1 se overlap, 0 se nao overlap.
 */
-int sobrepoe(const char *a1, const char *a2, const char *b1, const char *b2) {
-    if (cmp_date(a2, b1) <= 0) return 0;
-    if (cmp_date(b2, a1) <= 0) return 0;
-    return 1;
+int sobrepoe(Data a1, Data a2, Data b1, Data b2) {
+    return a1 < b2 && b1 < a2;
 }
 
-//gera codigo automatico (max + 1) lendo arquivo de registro
-int gerar_codigo_cliente() {
-    FILE *f = fopen(ARQ_CLIENTES, "rb");
-    if (!f) return 1;
-    Cliente c;
-    int max = 0;
-    while (fread(&c, sizeof(Cliente), 1, f) == 1) {
-        if (c.codigo > max) max = c.codigo;
-    }
-    fclose(f);
-    return max + 1;
-}
-int gerar_codigo_funcionario() {
-    FILE *f = fopen(ARQ_FUNCIONARIOS, "rb");
-    if (!f) return 1;
-    Funcionario x;
-    int max = 0;
-    while (fread(&x, sizeof(Funcionario), 1, f) == 1) {
-        if (x.codigo > max) max = x.codigo;
-    }
-    fclose(f);
-    return max + 1;
-}
-int gerar_codigo_estadia() {
-    FILE *f = fopen(ARQ_ESTADIAS, "rb");
-    if (!f) return 1;
-    Estadia e;
-    int max = 0;
-    while (fread(&e, sizeof(Estadia), 1, f) == 1) {
-        if (e.codigo > max) max = e.codigo;
+//campos de texto separados por ';' (lote, importacao, tarifas)
+
+// quebra a linha no lugar em campos separados por ';' e tira espacos das pontas
+size_t separar_campos(char *linha, char **campos, size_t max) {
+    size_t n = 0;
+    char *p = linha;
+    while (n < max) {
+        while (*p == ' ' || *p == '\t') p++;
+        campos[n++] = p;
+        char *fim = strchr(p, ';');
+        char *prox = fim ? fim + 1 : NULL;
+        if (!fim) fim = p + strlen(p);
+        while (fim > p && (fim[-1] == ' ' || fim[-1] == '\t' || fim[-1] == '\r' || fim[-1] == '\n')) fim--;
+        *fim = '\0';
+        if (!prox) break;
+        p = prox;
     }
-    fclose(f);
-    return max + 1;
+    return n;
 }
 
-//funcoes de Cliente
+void copiar_campo(char *destino, size_t tam, const char *campo) {
+    strncpy(destino, campo, tam - 1);
+    destino[tam - 1] = '\0';
+}
 
-void cadastrar_cliente() {
-    Cliente c;
-    c.codigo = gerar_codigo_cliente();
-    printf("Codigo gerado para cliente: %d\n", c.codigo);
-    printf("Nome: ");
-    limpar_buffer_scanf(); // Limpeza de buffer
-    fgets(c.nome, sizeof(c.nome), stdin); trim_newline(c.nome);
-    printf("Endereco: ");
-    fgets(c.endereco, sizeof(c.endereco), stdin); trim_newline(c.endereco);
-    printf("Telefone: ");
-    fgets(c.telefone, sizeof(c.telefone), stdin); trim_newline(c.telefone);
+int campo_inteiro(const char *campo, int *valor) {
+    char *fim;
+    long v = strtol(campo, &fim, 10);
+    if (fim == campo || *fim != '\0') return 0;
+    *valor = (int)v;
+    return 1;
+}
 
-    FILE *f = fopen(ARQ_CLIENTES, "ab");
-    if (!f) { perror("Erro ao abrir arquivo de clientes"); return; }
-    fwrite(&c, sizeof(Cliente), 1, f);
-    fclose(f);
-    printf("Cliente cadastrado com sucesso!\n");
+int campo_real(const char *campo, float *valor) {
+    char *fim;
+    double v = strtod(campo, &fim);
+    if (fim == campo || *fim != '\0') return 0;
+    *valor = (float)v;
+    return 1;
 }
 
-void mostrar_cliente(const Cliente *c) {
-    printf("Codigo: %d\nNome: %s\nEndereco: %s\nTelefone: %s\n",
-           c->codigo, c->nome, c->endereco, c->telefone);
+int campo_data(const char *campo, Data *valor) {
+    int d, m, a;
+    char resto;
+    return sscanf(campo, "%d/%d/%d%c", &d, &m, &a, &resto) == 3 && validar_data(d, m, a, valor);
 }
 
-//busca por codigo ou nome (substring, case-sensitive simples
-void pesquisar_cliente() {
-    printf("Pesquisar cliente por (1) codigo ou (2) nome? ");
-    int op; if (scanf("%d", &op) != 1) return;
-    FILE *f = fopen(ARQ_CLIENTES, "rb");
-    if (!f) { printf("Nenhum cliente cadastrado.\n"); return; }
-    Cliente c;
-    int achou = 0;
-    if (op == 1) {
-        int cod; printf("Codigo: "); scanf("%d", &cod);
-        limpar_buffer_scanf(); // Limpa buffer aps o scanf
-        while (fread(&c, sizeof(Cliente), 1, f) == 1) {
-            if (c.codigo == cod) { mostrar_cliente(&c); achou = 1; break; }
-        }
-    } else {
-        char busca[80];
-        printf("Nome (ou parte): ");
-        limpar_buffer_scanf(); // Limpeza de buffer
-        fgets(busca, sizeof(busca), stdin); trim_newline(busca);
-        while (fread(&c, sizeof(Cliente), 1, f) == 1) {
-            //busca simples: case-sensitive, aluno iniciante
-            if (strstr(c.nome, busca) != NULL) { mostrar_cliente(&c); printf("----\n"); achou = 1; }
-        }
-    }
-    if (!achou) printf("Cliente nao encontrado.\n");
-    fclose(f);
+//medicoes: latencia por operacao e contadores de E/S
+
+// relogio de parede em segundos, so para medir intervalos
+double agora_segundos() {
+#ifdef _WIN32
+    LARGE_INTEGER freq, agora;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&agora);
+    return (double)agora.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
 }
 
-//funcoes de Funcionario
+/* cada operacao medida tem um histograma de latencia em baldes de potencia
+   de 2 (balde b = de 2^(b-1) a 2^b microssegundos; balde 0 = menos de 1 us).
+   so chamadas que terminaram sem erro entram. os contadores somam registros
+   lidos e bytes gravados pelos auxiliares de arquivo. a tabela sai na opcao
+   18 do menu, em estatisticas.txt ao sair e, fora do Windows, com SIGUSR1
+   (no menu o arquivo e gravado depois da operacao em andamento). no modo
+   servidor as consultas correm juntas: os histogramas ficam sob uma trava
+   curta e o contador de lidos soma de forma atomica */
+#define ARQ_ESTATISTICAS "estatisticas.txt"
+#define MED_BALDES 32
 
-void cadastrar_funcionario() {
-    Funcionario func;
-    func.codigo = gerar_codigo_funcionario();
-    printf("Codigo gerado para funcionario: %d\n", func.codigo);
-    printf("Nome: ");
-    limpar_buffer_scanf(); // Limpeza de buffer
-    fgets(func.nome, sizeof(func.nome), stdin); trim_newline(func.nome);
-    printf("Telefone: ");
-    fgets(func.telefone, sizeof(func.telefone), stdin); trim_newline(func.telefone);
-    printf("Cargo: ");
-    fgets(func.cargo, sizeof(func.cargo), stdin); trim_newline(func.cargo);
-    printf("Salario: ");
-    scanf("%f", &func.salario);
-    limpar_buffer_scanf(); // Limpa buffer aps o scanf
+typedef enum {
+    MED_LER_REGISTRO,
+    MED_GRAVAR_REGISTRO,
+    MED_ANEXAR,
+    MED_ABRIR_DADOS,
+    MED_ABRIR_VISAO,
+    MED_DESCARREGAR,
+    MED_LER_CAUDA,
+    MED_QUARTO_EXISTE,
+    MED_BUSCA_NOME,
+    MED_COMANDO,
+    MED_CONSULTA,
+    MED_CONFIRMAR,
+    MED_MENU,                 // MED_MENU + opcao do menu (1 a 20)
+    MED_QTD = MED_MENU + 21
+} Medicao;
 
-    FILE *f = fopen(ARQ_FUNCIONARIOS, "ab");
-    if (!f) { perror("Erro ao abrir arquivo de funcionarios"); return; }
-    fwrite(&func, sizeof(Funcionario), 1, f);
-    fclose(f);
-    printf("Funcionario cadastrado com sucesso!\n");
+const char *nomes_medicoes[MED_QTD] = {
+    "ler_registro", "gravar_registro", "anexar_registros", "abrir_dados", "abrir_visao",
+    "descarregar_arquivo", "indice_ler_cauda", "quarto_existe", "texto_buscar", "comando", "consulta",
+    "transacao_confirmar",
+    "menu_sair", "menu_cadastrar_cliente", "menu_cadastrar_funcionario", "menu_cadastrar_quarto",
+    "menu_cadastrar_estadia", "menu_dar_baixa", "menu_pesquisar_cliente", "menu_pesquisar_funcionario",
+    "menu_estadias_cliente", "menu_pontos", "menu_listar_clientes", "menu_listar_quartos",
+    "menu_listar_estadias", "menu_politica_alocacao", "menu_ranking_fieis", "menu_relatorio_ocupacao",
+    "menu_disponibilidade", "menu_calendario", "menu_estatisticas",
+    "menu_arquivar", "menu_cotar"
+};
+
+typedef struct {
+    unsigned long chamadas;
+    double total;   // segundos
+    double maximo;
+    unsigned long baldes[MED_BALDES];
+} Histograma;
+
+Histograma medicoes[MED_QTD];
+unsigned long long med_registros_lidos = 0, med_bytes_gravados = 0, med_descargas = 0;
+volatile sig_atomic_t pedido_estatisticas = 0;
+#ifdef _WIN32
+SRWLOCK trava_medicoes = SRWLOCK_INIT;
+#else
+pthread_mutex_t trava_medicoes = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void travar_medicoes() {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&trava_medicoes);
+#else
+    pthread_mutex_lock(&trava_medicoes);
+#endif
 }
 
-void mostrar_funcionario(const Funcionario *p) {
-    printf("Codigo: %d\nNome: %s\nTelefone: %s\nCargo: %s\nSalario: %.2f\n",
-           p->codigo, p->nome, p->telefone, p->cargo, p->salario);
+void destravar_medicoes() {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&trava_medicoes);
+#else
+    pthread_mutex_unlock(&trava_medicoes);
+#endif
 }
 
-void pesquisar_funcionario() {
-    printf("Pesquisar funcionario por (1) codigo ou (2) nome? ");
-    int op; if (scanf("%d", &op) != 1) return;
-    FILE *f = fopen(ARQ_FUNCIONARIOS, "rb");
-    if (!f) { printf("Nenhum funcionario cadastrado.\n"); return; }
-    Funcionario p;
-    int achou = 0;
-    if (op == 1) {
-        int cod; printf("Codigo: "); scanf("%d", &cod);
-        limpar_buffer_scanf(); // Limpa buffer aps o scanf
-        while (fread(&p, sizeof(Funcionario), 1, f) == 1) {
-            if (p.codigo == cod) { mostrar_funcionario(&p); achou = 1; break; }
-        }
-    } else {
-        char busca[80];
-        printf("Nome (ou parte): ");
-        limpar_buffer_scanf(); // Limpeza de buffer
-        fgets(busca, sizeof(busca), stdin); trim_newline(busca);
-        while (fread(&p, sizeof(Funcionario), 1, f) == 1) {
-            if (strstr(p.nome, busca) != NULL) { mostrar_funcionario(&p); printf("----\n"); achou = 1; }
-        }
-    }
-    if (!achou) printf("Funcionario nao encontrado.\n");
-    fclose(f);
+// soma em med_registros_lidos de qualquer fio
+void contar_lidos(unsigned long long n) {
+#ifdef _WIN32
+    InterlockedExchangeAdd64((volatile LONG64 *)&med_registros_lidos, (LONG64)n);
+#else
+    __atomic_fetch_add(&med_registros_lidos, n, __ATOMIC_RELAXED);
+#endif
 }
 
-//funcoes de Quarto
+// fecha a medicao comecada em inicio (valor de agora_segundos)
+void medir(Medicao m, double inicio) {
+    double s = agora_segundos() - inicio;
+    unsigned long long us = (unsigned long long)(s * 1e6);
+    int b = 0;
+    while (us > 0 && b < MED_BALDES - 1) { us >>= 1; b++; }
+    Histograma *h = &medicoes[m];
+    travar_medicoes();
+    h->chamadas++;
+    h->total += s;
+    if (s > h->maximo) h->maximo = s;
+    h->baldes[b]++;
+    destravar_medicoes();
+}
 
-//verifica existencia de quarto por numero, se encontrado preenche q e retorna 1
-int quarto_existe(int numero, Quarto *q_out) {
-    FILE *f = fopen(ARQ_QUARTOS, "rb");
-    if (!f) return 0;
-    Quarto q;
-    while (fread(&q, sizeof(Quarto), 1, f) == 1) {
-        if (q.numero == numero) {
-            if (q_out) *q_out = q;
-            fclose(f);
-            return 1;
-        }
+// limite superior (us) do balde onde a fracao p das chamadas ja foi contada
+double percentil_us(const Histograma *h, double p) {
+    unsigned long alvo = (unsigned long)(p * h->chamadas), soma = 0;
+    for (int b = 0; b < MED_BALDES; ++b) {
+        soma += h->baldes[b];
+        if (soma > alvo || soma == h->chamadas) return (double)((unsigned long long)1 << b);
     }
-    fclose(f);
-    return 0;
+    return h->maximo * 1e6;
 }
 
-// regrava todo arquivo de quartos substituindo o quarto com mesmo numero
-int atualizar_quarto(Quarto q_atualizado) {
-    FILE *f = fopen(ARQ_QUARTOS, "rb");
-    if (!f) return 0;
-    // le todos para memoria simples (contador)
-    Quarto *lista = NULL;
-    size_t cont = 0;
-    Quarto temp;
-    while (fread(&temp, sizeof(Quarto), 1, f) == 1) {
-        lista = realloc(lista, (cont + 1) * sizeof(Quarto));
-        lista[cont++] = temp;
+void gravar_estatisticas(FILE *f) {
+    // copia os histogramas para nao escrever com a trava presa
+    Histograma copia[MED_QTD];
+    travar_medicoes();
+    memcpy(copia, medicoes, sizeof(copia));
+    destravar_medicoes();
+#ifdef _WIN32
+    unsigned long long lidos = (unsigned long long)InterlockedCompareExchange64((volatile LONG64 *)&med_registros_lidos, 0, 0);
+#else
+    unsigned long long lidos = __atomic_load_n(&med_registros_lidos, __ATOMIC_RELAXED);
+#endif
+    fprintf(f, "contador;registros_lidos;%llu\n", lidos);
+    fprintf(f, "contador;bytes_gravados;%llu\n", med_bytes_gravados);
+    fprintf(f, "contador;descargas_disco;%llu\n", med_descargas);
+    fprintf(f, "operacao;chamadas;media_us;max_us;p50_us;p99_us;histograma(limite_us:chamadas)\n");
+    for (int m = 0; m < MED_QTD; ++m) {
+        const Histograma *h = &copia[m];
+        if (h->chamadas == 0) continue;
+        fprintf(f, "%s;%lu;%.1f;%.1f;%.0f;%.0f;", nomes_medicoes[m], h->chamadas, h->total * 1e6 / h->chamadas,
+                h->maximo * 1e6, percentil_us(h, 0.5), percentil_us(h, 0.99));
+        for (int b = 0; b < MED_BALDES; ++b)
+            if (h->baldes[b]) fprintf(f, " %llu:%lu", (unsigned long long)1 << b, h->baldes[b]);
+        fprintf(f, "\n");
     }
-    fclose(f);
-    // atualizar
-    int achou = 0;
-    for (size_t i = 0; i < cont; ++i) {
-        if (lista[i].numero == q_atualizado.numero) {
+}
 
-            lista[i] = q_atualizado;
-            achou = 1;
-            break;
-        }
-    }
-    // reescrever arquivo
-    FILE *fw = fopen(ARQ_QUARTOS, "wb");
-    if (!fw) { free(lista); return 0; }
-    for (size_t i = 0; i < cont; ++i) fwrite(&lista[i], sizeof(Quarto), 1, fw);
-    fclose(fw);
-    free(lista);
-    return achou;
+int salvar_estatisticas() {
+    FILE *f = fopen(ARQ_ESTATISTICAS, "w");
+    if (!f) return 0;
+    gravar_estatisticas(f);
+    return fclose(f) == 0;
 }
 
-void cadastrar_quarto() {
-    Quarto q;
-    printf("Numero do quarto (inteiro): "); scanf("%d", &q.numero);
-    if (quarto_existe(q.numero, NULL)) {
-        printf("Erro: quarto ja existe.\n"); return;
-    }
-    printf("Quantidade de hospedes: "); scanf("%d", &q.qtdHospedes);
-    printf("Valor da diaria (R$): "); scanf("%f", &q.valorDiaria);
+void mostrar_estatisticas() {
+    gravar_estatisticas(stdout);
+}
 
-    limpar_buffer_scanf(); // Limpa o buffer aps o ltimo scanf
+#ifndef _WIN32
+void pedir_estatisticas(int sinal) {
+    (void)sinal;
+    pedido_estatisticas = 1;
+}
+#endif
 
-    q.ocupado = 0;
-    FILE *f = fopen(ARQ_QUARTOS, "ab");
-    if (!f) { perror("Erro ao abrir arquivo quartos"); return; }
-    fwrite(&q, sizeof(Quarto), 1, f);
-    fclose(f);
-    printf("Quarto cadastrado com sucesso!\n");
+// SIGUSR1 pendente: grava o arquivo agora
+void atender_pedido_estatisticas() {
+    if (!pedido_estatisticas) return;
+    pedido_estatisticas = 0;
+    if (!salvar_estatisticas()) printf("Aviso: nao foi possivel gravar %s.\n", ARQ_ESTATISTICAS);
 }
 
-//funcoes de Estadia
+//cabecalho dos arquivos .dat
 
-// verifica se existe alguma estadia ativa no mesmo quarto que conflita com periodo novo
-int periodo_livre(int numeroQuarto, const char *entrada, const char *saida) {
-    FILE *f = fopen(ARQ_ESTADIAS, "rb");
-    if (!f) return 1; // sem estadias -> livre
-    Estadia e;
-    while (fread(&e, sizeof(Estadia), 1, f) == 1) {
-        if (e.numeroQuarto == numeroQuarto && e.ativo == 1) {
-            if (sobrepoe(entrada, saida, e.dataEntrada, e.dataSaida)) {
-                fclose(f);
-                return 0; // nao livre
-            }
-        }
+const char *magia_do_arquivo(const char *arquivo) {
+    if (strcmp(arquivo, ARQ_CLIENTES) == 0) return "HDGC";
+    if (strcmp(arquivo, ARQ_FUNCIONARIOS) == 0) return "HDGF";
+    if (strcmp(arquivo, ARQ_QUARTOS) == 0) return "HDGQ";
+    if (strcmp(arquivo, ARQ_FIDELIDADE) == 0) return "HDGP";
+    if (strcmp(arquivo, ARQ_PARTICOES) == 0) return "HDGM";
+    return "HDGE";
+}
+
+// deslocamento em bytes do registro numero pos (pula o cabecalho)
+long deslocamento_registro(long pos, size_t tam_registro) {
+    return (long)sizeof(CabecalhoArquivo) + pos * (long)tam_registro;
+}
+
+void novo_cabecalho(CabecalhoArquivo *cab, const char *arquivo, size_t tam_registro) {
+    memset(cab, 0, sizeof(*cab));
+    memcpy(cab->magia, magia_do_arquivo(arquivo), 4);
+    cab->versao = FORMATO_VERSAO;
+    cab->tamRegistro = (uint16_t)tam_registro;
+}
+
+/* le e confere o cabecalho e deixa o arquivo no primeiro registro.
+   se o programa caiu entre gravar o registro e atualizar o cabecalho a
+   quantidade fica desatualizada, entao vale a quantidade de registros
+   inteiros que cabem no arquivo. retorna 1 se o formato bate */
+int cabecalho_confere(const CabecalhoArquivo *cab, const char *arquivo, size_t tam_registro) {
+    if (memcmp(cab->magia, magia_do_arquivo(arquivo), 4) != 0 ||
+        cab->versao != FORMATO_VERSAO || cab->tamRegistro != tam_registro) {
+        printf("Arquivo %s em formato desconhecido (rode com --converter).\n", arquivo);
+        return 0;
     }
-    fclose(f);
     return 1;
 }
 
-// regrava estadia por codigo (finalizar/atualizar)
-int atualizar_estadia(Estadia e_atualizada) {
-    FILE *f = fopen(ARQ_ESTADIAS, "rb");
-    if (!f) return 0;
-    Estadia *lista = NULL; size_t cont = 0; Estadia tmp;
-    while (fread(&tmp, sizeof(Estadia), 1, f) == 1) {
-        lista = realloc(lista, (cont + 1) * sizeof(Estadia));
-        lista[cont++] = tmp;
-    }
-    fclose(f);
-    int achou = 0;
-    for (size_t i = 0; i < cont; ++i) {
-        if (lista[i].codigo == e_atualizada.codigo) {
-            lista[i] = e_atualizada;
-            achou = 1; break;
-        }
+int ler_cabecalho(FILE *f, const char *arquivo, size_t tam_registro, CabecalhoArquivo *cab) {
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long tam = ftell(f);
+    rewind(f);
+    if (fread(cab, sizeof(*cab), 1, f) != 1) {
+        printf("Arquivo %s em formato desconhecido (rode com --converter).\n", arquivo);
+        return 0;
     }
-    FILE *fw = fopen(ARQ_ESTADIAS, "wb");
-    if (!fw) { free(lista); return 0; }
-    for (size_t i = 0; i < cont; ++i) fwrite(&lista[i], sizeof(Estadia), 1, fw);
-    fclose(fw); free(lista);
-    return achou;
+    if (!cabecalho_confere(cab, arquivo, tam_registro)) return 0;
+    long inteiros = (tam - (long)sizeof(*cab)) / (long)tam_registro;
+    if ((long)cab->quantidade != inteiros) cab->quantidade = (uint32_t)inteiros;
+    return 1;
 }
 
-void cadastrar_estadia() {
-    Estadia e;
-    e.codigo = gerar_codigo_estadia();
-    printf("Codigo gerado para estadia: %d\n", e.codigo);
+// fflush + forca o sistema a levar os dados ate o disco
+int descarregar_arquivo(FILE *f) {
+    double t = agora_segundos();
+    if (fflush(f) != 0) return 0;
+#ifdef _WIN32
+    int ok = _commit(_fileno(f)) == 0;
+#else
+    int ok = fsync(fileno(f)) == 0;
+#endif
+    if (ok) { med_descargas++; medir(MED_DESCARREGAR, t); }
+    return ok;
+}
 
-    printf("Codigo do cliente: ");
-    int temp_cod;
-    if (scanf("%d", &temp_cod) != 1) {
-        printf("Codigo do cliente invalido.\n");
-        limpar_buffer_scanf();
-        return;
-    }
-    e.codCliente = temp_cod;
+//travas entre processos (varios terminais na mesma pasta)
 
-    // verificar cliente existe
-    FILE *fc = fopen(ARQ_CLIENTES, "rb");
-    if (!fc) { printf("Nenhum cliente cadastrado.\n"); return; }
-    Cliente tmpc; int cliente_ok = 0;
-    while (fread(&tmpc, sizeof(Cliente), 1, fc) == 1) {
-        if (tmpc.codigo == e.codCliente) { cliente_ok = 1; break; }
-    }
-    fclose(fc);
-    if (!cliente_ok) { printf("Cliente nao encontrado.\n"); limpar_buffer_scanf(); return; }
+/* cada arquivo de dados tem um .lck ao lado que so serve para travas de
+   intervalo de bytes: o byte 0 trava o fim do arquivo (quem anexa e regrava
+   o cabecalho) e o byte pos + 1 trava o registro pos. a trava fica no .lck e
+   nao no proprio .dat porque no windows ela e obrigatoria e bloquearia a
+   leitura, e no posix fechar qualquer descritor do .dat soltaria as travas
+   do processo. quem so le (listagens, visoes, buscas) nunca abre o .lck e
+   nunca espera por quem esta gravando. */
+#define MAX_TRAVAS 8
+#define MAX_ADIADAS 64
 
-    printf("Quantidade de hospedes: ");
-    int qtd;
-    if (scanf("%d", &qtd) != 1) {
-        printf("Quantidade de hospedes invalida.\n");
-        limpar_buffer_scanf();
-        return;
-    }
-    limpar_buffer_scanf(); // Limpa o buffer APS o scanf de qtd
+#define TRAVA_SOLTAR 0
+#define TRAVA_ESPERAR 1
+#define TRAVA_TENTAR 2 // nao espera: retorna 0 se outro processo tem
 
-    // NOVO: Leitura de data separada
-    if (!ler_e_formatar_data("Data de entrada", e.dataEntrada)) return;
-    if (!ler_e_formatar_data("Data de saida", e.dataSaida)) return;
+typedef struct {
+    const char *arquivo;
+#ifdef _WIN32
+    HANDLE h;
+#else
+    int fd;
+#endif
+    long adiadas[MAX_ADIADAS];           // bytes soltos no lote ou na transacao, ainda travados no .lck
+    uint8_t da_transacao[MAX_ADIADAS]; // solto na transacao aberta: so sai depois do commit dela
+    size_t qtd_adiadas;
+} ArquivoTrava;
 
-    int dias = diff_days_simple(e.dataEntrada, e.dataSaida);
-    if (dias <= 0) {
-        printf("Periodo invalido (saida deve ser apos entrada).\n");
-        return;
-    }
-    e.qtdDiarias = dias;
-    e.ativo = 1;
-
-    // procurar quarto disponivel (desocupado e com capacidade >= qtd e sem periodo conflito)
-    FILE *fq = fopen(ARQ_QUARTOS, "rb");
-    if (!fq) { printf("Nenhum quarto cadastrado.\n"); return; }
-    Quarto qtmp; int encontrado = 0;
-    while (fread(&qtmp, sizeof(Quarto), 1, fq) == 1) {
-        // Para simplificar, estamos considerando quartos "desocupados" (ocupado == 0) ou que no tm conflito de datas.
-        // A lgica mais correta seria apenas verificar o conflito de datas, ignorando o campo 'ocupado'
-        // que deve ser usado apenas para estadias sem data de sada (check-in atual), o que no  o caso aqui.
-        if (qtmp.qtdHospedes >= qtd) {
-            if (periodo_livre(qtmp.numero, e.dataEntrada, e.dataSaida)) {
-                encontrado = 1;
-                break;
-            }
-        }
-    }
-    fclose(fq);
-    if (!encontrado) { printf("Nenhum quarto disponivel para o periodo e capacidade.\n"); return; }
-    e.numeroQuarto = qtmp.numero;
+ArquivoTrava travas[MAX_TRAVAS];
+size_t qtd_travas = 0;
 
-    // gravar estadia
-    FILE *fe = fopen(ARQ_ESTADIAS, "ab");
-    if (!fe) { perror("Erro ao abrir arquivo estadias"); return; }
-    fwrite(&e, sizeof(Estadia), 1, fe);
-    fclose(fe);
+// .lck do arquivo, aberto na primeira vez e mantido ate o fim do processo
+ArquivoTrava *arquivo_trava(const char *arquivo) {
+    for (size_t i = 0; i < qtd_travas; ++i)
+        if (strcmp(travas[i].arquivo, arquivo) == 0) return &travas[i];
+    if (qtd_travas == MAX_TRAVAS) return NULL;
+    char nome[64];
+    snprintf(nome, sizeof(nome), "%s.lck", arquivo);
+    ArquivoTrava *t = &travas[qtd_travas];
+    t->arquivo = arquivo;
+    t->qtd_adiadas = 0;
+#ifdef _WIN32
+    t->h = CreateFileA(nome, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                       OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (t->h == INVALID_HANDLE_VALUE) return NULL;
+#else
+    t->fd = open(nome, O_RDWR | O_CREAT, 0644);
+    if (t->fd < 0) return NULL;
+#endif
+    qtd_travas++;
+    return t;
+}
 
-    // Na lgica ideal, o quarto s ficaria ocupado se fosse uma estadia aberta,
-    // mas mantemos a lgica original para evitar mudar as regras do seu trabalho.
-    if (qtmp.ocupado == 0) {
-        qtmp.ocupado = 1;
-        if (!atualizar_quarto(qtmp)) {
-            printf("Aviso: nao foi possivel atualizar status do quarto (arquivo quartos).\n");
-        }
+/* trava (TRAVA_ESPERAR espera se outro processo tem) ou solta tam bytes
+   do .lck a partir de byte (tam 0 = ate o fim) */
+int trava_bytes(const char *arquivo, long byte, long tam, int modo) {
+    ArquivoTrava *t = arquivo_trava(arquivo);
+    if (!t) return 0;
+#ifdef _WIN32
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)byte;
+    DWORD bytes = tam > 0 ? (DWORD)tam : MAXDWORD;
+    if (modo == TRAVA_SOLTAR) return UnlockFileEx(t->h, 0, bytes, 0, &ov) != 0;
+    DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | (modo == TRAVA_TENTAR ? LOCKFILE_FAIL_IMMEDIATELY : 0);
+    return LockFileEx(t->h, flags, 0, bytes, 0, &ov) != 0;
+#else
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = modo == TRAVA_SOLTAR ? F_UNLCK : F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = byte;
+    fl.l_len = tam;
+    while (fcntl(t->fd, modo == TRAVA_TENTAR ? F_SETLK : F_SETLKW, &fl) != 0) {
+        if (errno != EINTR) return 0;
     }
+    return 1;
+#endif
+}
 
-    printf("Estadia cadastrada! Codigo: %d | Quarto: %d | Diarias: %d\n",
-           e.codigo, e.numeroQuarto, e.qtdDiarias);
+int trava_byte(const char *arquivo, long byte, int modo) { return trava_bytes(arquivo, byte, 1, modo); }
+
+// 1 se o byte ja e nosso, solto no lote mas ainda nao no .lck
+int trava_adiada(ArquivoTrava *t, long byte) {
+    for (size_t i = 0; i < t->qtd_adiadas; ++i)
+        if (t->adiadas[i] == byte) return 1;
+    return 0;
 }
 
-// dar baixa em uma estadia: definir ativo=0 e liberar quarto
-void dar_baixa_estadia() {
-    printf("Codigo da estadia para dar baixa: ");
-    int cod; scanf("%d", &cod);
-    limpar_buffer_scanf(); // Limpeza de buffer
+/* guarda o byte para soltar no descarregamento (ou no commit, se
+   da_transacao). retorna 0 se a lista encheu */
+int adiar_trava(ArquivoTrava *t, long byte, int da_transacao) {
+    if (trava_adiada(t, byte)) return 1;
+    if (t->qtd_adiadas == MAX_ADIADAS) return 0;
+    t->da_transacao[t->qtd_adiadas] = (uint8_t)da_transacao;
+    t->adiadas[t->qtd_adiadas++] = byte;
+    return 1;
+}
 
-    FILE *f = fopen(ARQ_ESTADIAS, "rb");
-    if (!f) { printf("Nenhuma estadia registrada.\n"); return; }
-    Estadia e; int achou = 0;
-    while (fread(&e, sizeof(Estadia), 1, f) == 1) {
-        if (e.codigo == cod) { achou = 1; break; }
+/* trava adiada voltando a ser usada: sai da lista para o descarregamento
+   nao solta-la no meio do comando. retorna 0 se nao estava la */
+int retomar_trava(ArquivoTrava *t, long byte) {
+    for (size_t i = 0; i < t->qtd_adiadas; ++i)
+        if (t->adiadas[i] == byte) {
+            t->qtd_adiadas--;
+            t->adiadas[i] = t->adiadas[t->qtd_adiadas];
+            t->da_transacao[i] = t->da_transacao[t->qtd_adiadas];
+            return 1;
+        }
+    return 0;
+}
+
+int travas_adiadas_pendentes() {
+    for (size_t i = 0; i < qtd_travas; ++i)
+        if (travas[i].qtd_adiadas > 0) return 1;
+    return 0;
+}
+
+/* solta as adiadas do grupo (soltar_grupo) ou as da transacao aberta; as
+   outras ficam na lista */
+void soltar_adiadas(int soltar_grupo) {
+    for (size_t i = 0; i < qtd_travas; ++i) {
+        ArquivoTrava *t = &travas[i];
+        size_t ficam = 0;
+        for (size_t j = 0; j < t->qtd_adiadas; ++j) {
+            if ((t->da_transacao[j] == 0) == soltar_grupo) {
+                trava_byte(t->arquivo, t->adiadas[j], TRAVA_SOLTAR);
+                continue;
+            }
+            t->adiadas[ficam] = t->adiadas[j];
+            t->da_transacao[ficam++] = t->da_transacao[j];
+        }
+        t->qtd_adiadas = ficam;
     }
-    fclose(f);
-    if (!achou) { printf("Estadia nao encontrada.\n"); return; }
-    if (e.ativo == 0) { printf("Estadia ja finalizada.\n"); return; }
+}
 
-    // obter valor diaria do quart
-    Quarto q; if (!quarto_existe(e.numeroQuarto, &q)) { printf("Quarto nao encontrado (erro de consistencia).\n"); return; }
-    float total = e.qtdDiarias * q.valorDiaria;
-    printf("Total a pagar: %d diarias x R$ %.2f = R$ %.2f\n", e.qtdDiarias, q.valorDiaria, total);
+// depois do fsync do grupo: agora os outros processos podem ver e regravar
+void soltar_travas_adiadas() { soltar_adiadas(1); }
 
-    // marcar estadia como finalizada e atualizar arquivo
-    e.ativo = 0;
-    if (!atualizar_estadia(e)) { printf("Erro ao atualizar arquivo de estadias.\n"); return; }
+/* fim da transacao: as travas dela sao soltas ou, no lote, passam a ser do
+   grupo e esperam o fsync do diario */
+void encerrar_travas_transacao(int soltar) {
+    if (soltar) { soltar_adiadas(0); return; }
+    for (size_t i = 0; i < qtd_travas; ++i)
+        memset(travas[i].da_transacao, 0, sizeof(travas[i].da_transacao));
+}
 
-    // liberar quarto
-    q.ocupado = 0;
-    if (!atualizar_quarto(q)) {
-        printf("Erro ao atualizar arquivo de quartos.\n");
-    } else {
-        printf("Baixa registrada e quarto liberado.\n");
-    }
+// 1 se f ainda e o arquivo com esse nome (nao foi trocado por outro)
+int mesmo_arquivo(FILE *f, const char *arquivo) {
+#ifdef _WIN32
+    (void)f; (void)arquivo;
+    return 1; // no windows um arquivo aberto nao pode ser substituido
+#else
+    struct stat s, d;
+    return stat(arquivo, &s) == 0 && fstat(fileno(f), &d) == 0 && s.st_ino == d.st_ino && s.st_dev == d.st_dev;
+#endif
+}
+
+// troca arquivo por novo de uma vez: quem abrir depois ve um ou outro inteiro
+int substituir_arquivo(const char *novo, const char *arquivo) {
+#ifdef _WIN32
+    return MoveFileExA(novo, arquivo, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(novo, arquivo) == 0;
+#endif
+}
+
+// corta o arquivo aberto em tam bytes
+int cortar_aberto(FILE *f, long tam) {
+    if (fflush(f) != 0) return 0;
+#ifdef _WIN32
+    return _chsize(_fileno(f), tam) == 0;
+#else
+    return ftruncate(fileno(f), tam) == 0;
+#endif
+}
+
+//diario de transacoes (write-ahead log)
+
+/* toda gravacao nos .dat passa pelo diario (diario.jnl). uma transacao junta
+   em memoria as gravacoes de uma operacao (a reserva: estadia nova, agregado
+   e status do quarto; a baixa: estadia, cabecalho, agregado e quarto). no
+   commit elas vao para o fim do diario num bloco so, com soma de
+   verificacao, um fsync, e so entao sao aplicadas nos arquivos de dados, sem
+   fsync. se o programa cair antes do bloco ficar completo a soma nao bate e
+   nada da transacao vale; se cair depois, o bloco e reaplicado. quando o
+   diario passa de DIARIO_LIMITE os arquivos de dados vao para o disco e ele
+   volta a ficar vazio (checkpoint): a recuperacao le no maximo esse tanto,
+   qualquer que seja o tamanho dos dados. as travas soltas no meio de uma
+   transacao so sao soltas no commit, e a trava do diario e sempre a ultima
+   a ser pega (quem a tem nao espera por mais nada). se a pasta tem
+   alteracoes.log, as alteracoes publicadas na transacao (cadastros e
+   regravacoes de quarto e estadia) entram no mesmo bloco, no fim do log:
+   o log tem exatamente o que foi para os .dat, na ordem dos commits. */
+#define DIARIO_LIMITE (1 << 20)
+#define DIARIO_ABERTOS 8
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char magia[4];     // "WAL1"
+    uint32_t aplicado; // bytes do diario que ja estao nos arquivos de dados
+    uint8_t publicado; // a pasta tem alteracoes.log (o commit nao precisa procurar)
+    uint8_t reservado[7];
+} CabecalhoDiario;
+
+// bloco de um commit: qtd gravacoes (GravacaoDiario + bytes) nos tam bytes seguintes
+typedef struct {
+    char magia[4]; // "TXN1"
+    uint32_t tam;
+    uint32_t qtd;
+    uint32_t soma; // FNV-1a do cabecalho ate aqui e das gravacoes
+} CabecalhoTransacao;
+
+typedef struct {
+    char arquivo[24];
+    uint32_t deslocamento; // em bytes
+    uint32_t tam;
+} GravacaoDiario;
+
+typedef struct {
+    char magia[4];     // "ALT1"
+    uint32_t proxima;  // sequencia da proxima alteracao
+    uint32_t fim;      // bytes do log que ja valem
+    uint32_t origem;   // quando o log foi criado: a replica confere se segue o mesmo
+} CabecalhoAlteracoes;
+
+// uma alteracao do log, seguida de tam bytes do registro inteiro
+typedef struct {
+    uint32_t sequencia;
+    uint8_t tipo;      // TipoAlteracao
+    uint8_t operacao;  // ALT_INSERCAO ou ALT_ATUALIZACAO
+    uint16_t tam;
+    uint32_t soma;     // FNV-1a do cabecalho ate aqui e do registro
+} Alteracao;
+
+#pragma pack(pop)
+
+typedef enum { ALT_CLIENTE = 1, ALT_FUNCIONARIO, ALT_QUARTO, ALT_ESTADIA } TipoAlteracao;
+#define ALT_INSERCAO 'I'
+#define ALT_ATUALIZACAO 'A'
+
+typedef struct {
+    int nivel;    // transacao_iniciar aninhados; o commit e no ultimo confirmar
+    char *dados;  // gravacoes pendentes, ja no formato do bloco
+    size_t tam, cap;
+    uint32_t qtd;
+    char *publicadas; // alteracoes para o log (Alteracao + registro), numeradas no commit
+    size_t tam_publicadas, cap_publicadas;
+    int falhou;   // uma parte falhou: o commit nao grava nada
+} Transacao;
+
+typedef struct {
+    char arquivo[24];
+    FILE *f;
+} ArquivoAplicado;
+
+Transacao transacao;
+int modo_lote = 0;          // no lote o fsync do diario fica para o descarregamento do grupo
+int diario_pendente = 0;    // lote: blocos no diario ainda sem fsync
+FILE *diario_lote = NULL;   // lote: diario aberto entre um commit e outro
+ArquivoAplicado aplicados[DIARIO_ABERTOS]; // arquivos de dados abertos (no lote, o lote inteiro)
+size_t qtd_aplicados = 0;
+
+// FNV-1a de 32 bits
+unsigned int soma_verificacao(const void *dados, size_t n, unsigned int h) {
+    const unsigned char *p = dados;
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 16777619u; }
+    return h;
+}
+
+// fecha os arquivos de dados abertos para aplicar (sem fsync: o diario garante)
+int fechar_aplicados() {
+    int ok = 1;
+    for (size_t i = 0; i < qtd_aplicados; ++i)
+        if (fclose(aplicados[i].f) != 0) ok = 0;
+    qtd_aplicados = 0;
+    return ok;
+}
+
+// arquivo de dados aberto para aplicar gravacoes; cria se nao existe
+FILE *arquivo_aplicado(const char *arquivo) {
+    for (size_t i = 0; i < qtd_aplicados; ++i)
+        if (strcmp(aplicados[i].arquivo, arquivo) == 0) return aplicados[i].f;
+    if (qtd_aplicados == DIARIO_ABERTOS) fechar_aplicados();
+    FILE *f = fopen(arquivo, "r+b");
+    if (!f && !(f = fopen(arquivo, "w+b"))) return NULL;
+    ArquivoAplicado *a = &aplicados[qtd_aplicados++];
+    strncpy(a->arquivo, arquivo, sizeof(a->arquivo) - 1);
+    a->arquivo[sizeof(a->arquivo) - 1] = '\0';
+    a->f = f;
+    return f;
+}
+
+/* trava nova no lote: se o arquivo foi trocado (compactacao) o aberto aqui
+   ainda e o antigo e e fechado, para ser reaberto no proximo uso. nada fica
+   pendente nele porque cada bloco e descarregado do buffer ao ser aplicado */
+void conferir_aplicado(const char *arquivo) {
+    for (size_t i = 0; i < qtd_aplicados; ++i) {
+        if (strcmp(aplicados[i].arquivo, arquivo) != 0) continue;
+        if (!mesmo_arquivo(aplicados[i].f, arquivo)) {
+            fclose(aplicados[i].f);
+            aplicados[i] = aplicados[--qtd_aplicados];
+        }
+        return;
+    }
+}
+
+int aplicar_gravacao(const char *arquivo, long deslocamento, const void *dados, size_t tam) {
+    FILE *f = arquivo_aplicado(arquivo);
+    int ok = f != NULL && fseek(f, deslocamento, SEEK_SET) == 0 && fwrite(dados, tam, 1, f) == 1;
+    if (ok) med_bytes_gravados += tam;
+    return ok;
+}
+
+/* aplica as gravacoes de um bloco, na ordem. no fim tudo sai do buffer do
+   stdio, para os outros processos (e o checkpoint) enxergarem */
+int aplicar_transacao(const char *dados, size_t tam, uint32_t qtd) {
+    int ok = 1;
+    size_t p = 0;
+    for (uint32_t i = 0; ok && i < qtd; ++i) {
+        GravacaoDiario g;
+        if (tam - p < sizeof(g)) return 0;
+        memcpy(&g, dados + p, sizeof(g));
+        p += sizeof(g);
+        if (g.tam > tam - p) return 0;
+        g.arquivo[sizeof(g.arquivo) - 1] = '\0';
+        ok = aplicar_gravacao(g.arquivo, g.deslocamento, dados + p, g.tam);
+        p += g.tam;
+    }
+    for (size_t i = 0; i < qtd_aplicados; ++i)
+        if (fflush(aplicados[i].f) != 0) ok = 0;
+    return ok;
+}
+
+// abre o diario e le o cabecalho; diario que nao existe (ou ficou sem cabecalho) comeca vazio
+FILE *diario_abrir(CabecalhoDiario *cab) {
+    FILE *j = diario_lote;
+    if (!j && !(j = fopen(ARQ_DIARIO, "r+b")) && !(j = fopen(ARQ_DIARIO, "w+b"))) return NULL;
+    rewind(j);
+    if (fread(cab, sizeof(*cab), 1, j) != 1 || memcmp(cab->magia, "WAL1", 4) != 0) {
+        memset(cab, 0, sizeof(*cab));
+        memcpy(cab->magia, "WAL1", 4);
+        cab->aplicado = sizeof(*cab);
+        FILE *log = fopen(ARQ_ALTERACOES, "rb");
+        if (log) { cab->publicado = 1; fclose(log); }
+        if (!cortar_aberto(j, 0) || fseek(j, 0, SEEK_SET) != 0 ||
+            fwrite(cab, sizeof(*cab), 1, j) != 1 || fflush(j) != 0) {
+            if (j != diario_lote) fclose(j);
+            return NULL;
+        }
+    }
+    if (modo_lote) diario_lote = j;
+    return j;
+}
+
+void diario_fechar(FILE *j) {
+    if (j != diario_lote) fclose(j);
+}
+
+/* reaplica os blocos completos de desde em diante e corta o que sobrar
+   depois deles (bloco pela metade de quem caiu no meio do commit). retorna
+   o fim do que vale ou -1 */
+long diario_reaplicar(FILE *j, long desde) {
+    if (fseek(j, 0, SEEK_END) != 0) return -1;
+    long tam = ftell(j), pos = desde;
+    if (pos >= tam) return tam;
+    char *dados = NULL;
+    size_t cap = 0;
+    CabecalhoTransacao ct;
+    while (tam - pos >= (long)sizeof(ct)) {
+        if (fseek(j, pos, SEEK_SET) != 0 || fread(&ct, sizeof(ct), 1, j) != 1 ||
+            memcmp(ct.magia, "TXN1", 4) != 0 || ct.tam > (uint32_t)(tam - pos - (long)sizeof(ct))) break;
+        if (ct.tam > cap) {
+            char *maior = realloc(dados, ct.tam);
+            if (!maior) break;
+            dados = maior;
+            cap = ct.tam;
+        }
+        if (ct.tam > 0 && fread(dados, ct.tam, 1, j) != 1) break;
+        if (ct.soma != soma_verificacao(dados, ct.tam, soma_verificacao(&ct, offsetof(CabecalhoTransacao, soma), 2166136261u))) break;
+        if (!aplicar_transacao(dados, ct.tam, ct.qtd)) { free(dados); return -1; }
+        pos += (long)sizeof(ct) + (long)ct.tam;
+    }
+    free(dados);
+    if (pos < tam && !cortar_aberto(j, pos)) return -1;
+    return pos;
+}
+
+// ate onde os arquivos de dados ja tem o diario (sem fsync: so vale enquanto o sistema nao cai)
+int diario_marcar_aplicado(FILE *j, CabecalhoDiario *cab, long fim) {
+    cab->aplicado = (uint32_t)fim;
+    return fseek(j, 0, SEEK_SET) == 0 && fwrite(cab, sizeof(*cab), 1, j) == 1 && fflush(j) == 0;
+}
+
+/* checkpoint: leva os arquivos de dados ao disco e esvazia o diario. chamar
+   com o diario travado e tudo aplicado */
+int diario_checkpoint(FILE *j, CabecalhoDiario *cab) {
+    const char *arquivos[] = { ARQ_CLIENTES, ARQ_FUNCIONARIOS, ARQ_QUARTOS, ARQ_ESTADIAS,
+                               ARQ_FIDELIDADE, ARQ_PARTICOES, ARQ_ALTERACOES, ARQ_SEGUIDOR };
+    for (size_t i = 0; i < sizeof(arquivos) / sizeof(arquivos[0]); ++i) {
+        FILE *f = fopen(arquivos[i], "r+b");
+        if (!f) continue;
+        int ok = descarregar_arquivo(f);
+        fclose(f);
+        if (!ok) return 0;
+    }
+    return cortar_aberto(j, sizeof(*cab)) && diario_marcar_aplicado(j, cab, sizeof(*cab)) &&
+           descarregar_arquivo(j);
+}
+
+// poe mais uma gravacao no bloco da transacao
+int transacao_juntar(const char *arquivo, long deslocamento, const void *dados, size_t tam) {
+    size_t precisa = transacao.tam + sizeof(GravacaoDiario) + tam;
+    if (precisa > transacao.cap) {
+        size_t cap = transacao.cap ? transacao.cap : 4096;
+        while (cap < precisa) cap *= 2;
+        char *maior = realloc(transacao.dados, cap);
+        if (!maior) { transacao.falhou = 1; return 0; }
+        transacao.dados = maior;
+        transacao.cap = cap;
+    }
+    GravacaoDiario g;
+    memset(&g, 0, sizeof(g));
+    strncpy(g.arquivo, arquivo, sizeof(g.arquivo) - 1);
+    g.deslocamento = (uint32_t)deslocamento;
+    g.tam = (uint32_t)tam;
+    memcpy(transacao.dados + transacao.tam, &g, sizeof(g));
+    memcpy(transacao.dados + transacao.tam + sizeof(g), dados, tam);
+    transacao.tam = precisa;
+    transacao.qtd++;
+    return 1;
+}
+
+/* guarda o registro inteiro como alteracao para o log. chamar com a
+   transacao aberta, antes da gravacao: sequencia e soma so no commit */
+int publicar_alteracao(TipoAlteracao tipo, char operacao, const void *reg, size_t tam) {
+    size_t precisa = transacao.tam_publicadas + sizeof(Alteracao) + tam;
+    if (precisa > transacao.cap_publicadas) {
+        size_t cap = transacao.cap_publicadas ? transacao.cap_publicadas : 1024;
+        while (cap < precisa) cap *= 2;
+        char *maior = realloc(transacao.publicadas, cap);
+        if (!maior) { transacao.falhou = 1; return 0; }
+        transacao.publicadas = maior;
+        transacao.cap_publicadas = cap;
+    }
+    Alteracao a;
+    memset(&a, 0, sizeof(a));
+    a.tipo = (uint8_t)tipo;
+    a.operacao = (uint8_t)operacao;
+    a.tam = (uint16_t)tam;
+    memcpy(transacao.publicadas + transacao.tam_publicadas, &a, sizeof(a));
+    memcpy(transacao.publicadas + transacao.tam_publicadas + sizeof(a), reg, tam);
+    transacao.tam_publicadas = precisa;
+    return 1;
+}
+
+/* com o diario travado e aplicado: numera as alteracoes publicadas a partir
+   do cabecalho do log e junta no bloco a gravacao delas no fim e a do
+   cabecalho novo. sem log (ninguem publicou esta pasta) nao faz nada */
+int alteracoes_juntar(const CabecalhoDiario *diario) {
+    if (transacao.tam_publicadas == 0 || !diario->publicado) return 1;
+    conferir_aplicado(ARQ_ALTERACOES); // lote: o log pode ter sido criado de novo
+    FILE *f = fopen(ARQ_ALTERACOES, "rb");
+    if (!f) return 1;
+    CabecalhoAlteracoes cab;
+    int lido = fread(&cab, sizeof(cab), 1, f) == 1 && memcmp(cab.magia, "ALT1", 4) == 0;
+    fclose(f);
+    if (!lido) return 1;
+    for (size_t p = 0; p < transacao.tam_publicadas;) {
+        Alteracao a;
+        memcpy(&a, transacao.publicadas + p, sizeof(a));
+        a.sequencia = cab.proxima++;
+        a.soma = soma_verificacao(transacao.publicadas + p + sizeof(a), a.tam,
+                                  soma_verificacao(&a, offsetof(Alteracao, soma), 2166136261u));
+        memcpy(transacao.publicadas + p, &a, sizeof(a));
+        p += sizeof(a) + a.tam;
+    }
+    long fim = (long)cab.fim;
+    cab.fim += (uint32_t)transacao.tam_publicadas;
+    // o cabecalho vai depois: quem le o log nunca ve um fim sem as alteracoes
+    return transacao_juntar(ARQ_ALTERACOES, fim, transacao.publicadas, transacao.tam_publicadas) &&
+           transacao_juntar(ARQ_ALTERACOES, 0, &cab, sizeof(cab));
+}
+
+/* grava o bloco da transacao no fim do diario (fsync, fora do lote) e
+   aplica. antes, o que outro processo deixou de aplicar ao cair e reaplicado */
+int diario_commit() {
+    if (!trava_byte(ARQ_DIARIO, 0, TRAVA_ESPERAR)) return 0;
+    CabecalhoDiario cab;
+    FILE *j = diario_abrir(&cab);
+    long fim = j ? diario_reaplicar(j, cab.aplicado) : -1;
+    CabecalhoTransacao ct;
+    int ok = fim >= 0 && alteracoes_juntar(&cab);
+    if (ok) {
+        memcpy(ct.magia, "TXN1", 4);
+        ct.tam = (uint32_t)transacao.tam;
+        ct.qtd = transacao.qtd;
+        ct.soma = soma_verificacao(transacao.dados, transacao.tam,
+                                   soma_verificacao(&ct, offsetof(CabecalhoTransacao, soma), 2166136261u));
+    }
+    ok = ok && fseek(j, fim, SEEK_SET) == 0 &&
+             fwrite(&ct, sizeof(ct), 1, j) == 1 &&
+             (ct.tam == 0 || fwrite(transacao.dados, ct.tam, 1, j) == 1) &&
+             (modo_lote ? fflush(j) == 0 : descarregar_arquivo(j));
+    if (ok) {
+        fim += (long)sizeof(ct) + (long)ct.tam;
+        med_bytes_gravados += sizeof(ct) + ct.tam;
+        if (modo_lote) diario_pendente = 1;
+        // a transacao ja vale: se a aplicacao falhar o bloco fica para a recuperacao
+        ok = aplicar_transacao(transacao.dados, transacao.tam, transacao.qtd) &&
+             diario_marcar_aplicado(j, &cab, fim);
+        if (ok && !modo_lote && fim > DIARIO_LIMITE && !diario_checkpoint(j, &cab))
+            printf("Aviso: checkpoint do diario falhou (fica para o proximo).\n");
+    }
+    if (!modo_lote && !fechar_aplicados()) ok = 0;
+    if (j) diario_fechar(j);
+    trava_byte(ARQ_DIARIO, 0, TRAVA_SOLTAR);
+    return ok;
+}
+
+void transacao_iniciar() {
+    transacao.nivel++;
+}
+
+/* fecha a transacao mais de dentro; a de fora faz o commit (tudo ou nada).
+   retorna 0 se a transacao nao foi gravada */
+int transacao_confirmar() {
+    if (--transacao.nivel > 0) return !transacao.falhou;
+    double t = agora_segundos();
+    int ok = !transacao.falhou && (transacao.qtd == 0 || diario_commit());
+    transacao.tam = transacao.qtd = 0;
+    transacao.tam_publicadas = 0;
+    transacao.falhou = 0;
+    encerrar_travas_transacao(!modo_lote);
+    if (ok) medir(MED_CONFIRMAR, t);
+    return ok;
+}
+
+/* desiste da transacao mais de dentro: a de fora inteira nao grava nada.
+   quem chama refaz o que ja tinha posto em memoria (indices) */
+void transacao_descartar() {
+    transacao.falhou = 1;
+    transacao_confirmar();
+}
+
+/* guarda uma gravacao na transacao aberta. sem transacao aberta ela e uma
+   transacao sozinha, com commit na hora */
+int transacao_gravar(const char *arquivo, long deslocamento, const void *dados, size_t tam) {
+    if (transacao.nivel == 0) {
+        transacao_iniciar();
+        transacao_gravar(arquivo, deslocamento, dados, tam);
+        return transacao_confirmar();
+    }
+    return transacao_juntar(arquivo, deslocamento, dados, tam);
+}
+
+/* quem le dentro da transacao ve as proprias gravacoes: copia para destino
+   o que ela ja gravou em [deslocamento, deslocamento + tam) do arquivo.
+   retorna 1 se uma gravacao cobriu o trecho inteiro */
+int transacao_sobrepor(const char *arquivo, long deslocamento, void *destino, size_t tam) {
+    int inteiro = 0;
+    for (size_t p = 0; p < transacao.tam;) {
+        GravacaoDiario g;
+        memcpy(&g, transacao.dados + p, sizeof(g));
+        const char *bytes = transacao.dados + p + sizeof(g);
+        p += sizeof(g) + g.tam;
+        if (strcmp(g.arquivo, arquivo) != 0) continue;
+        long ini = deslocamento > (long)g.deslocamento ? deslocamento : (long)g.deslocamento;
+        long fim = deslocamento + (long)tam < (long)(g.deslocamento + g.tam) ? deslocamento + (long)tam
+                                                                             : (long)(g.deslocamento + g.tam);
+        if (ini >= fim) continue;
+        memcpy((char *)destino + (ini - deslocamento), bytes + (ini - (long)g.deslocamento), (size_t)(fim - ini));
+        if (fim - ini == (long)tam) inteiro = 1;
+    }
+    return inteiro;
+}
+
+/* lote: o fsync do diario para o grupo inteiro e, se ele ja passou do
+   limite, o checkpoint */
+int diario_descarregar() {
+    if (!diario_pendente) return 1;
+    if (!trava_byte(ARQ_DIARIO, 0, TRAVA_ESPERAR)) return 0;
+    CabecalhoDiario cab;
+    FILE *j = diario_abrir(&cab);
+    long fim = j ? diario_reaplicar(j, cab.aplicado) : -1;
+    int ok = fim >= 0 && descarregar_arquivo(j);
+    if (ok) {
+        diario_pendente = 0;
+        if (diario_marcar_aplicado(j, &cab, fim) && fim > DIARIO_LIMITE && !diario_checkpoint(j, &cab))
+            printf("Aviso: checkpoint do diario falhou (fica para o proximo).\n");
+    }
+    if (j) diario_fechar(j);
+    trava_byte(ARQ_DIARIO, 0, TRAVA_SOLTAR);
+    return ok;
+}
+
+// diario de uma versao anterior (uma gravacao so): reaplicado se completo
+typedef struct {
+    char magia[4]; // "JNL1"
+    char arquivo[32];
+    long deslocamento;
+    int tamanho;
+    unsigned int soma;
+} DiarioAntigo;
+
+// retorna 0 se ele ficou (nao foi possivel reaplicar)
+int recuperar_diario_antigo() {
+    FILE *j = fopen(ARQ_DIARIO, "rb");
+    if (!j) return 1;
+    DiarioAntigo cab;
+    char *dados = NULL;
+    int antigo = fread(&cab, sizeof(cab), 1, j) == 1 && memcmp(cab.magia, "JNL1", 4) == 0;
+    int ok = antigo && cab.tamanho > 0 && cab.tamanho <= 4096 &&
+             (dados = malloc(cab.tamanho)) != NULL && fread(dados, cab.tamanho, 1, j) == 1;
+    fclose(j);
+    if (!antigo) { free(dados); return 1; }
+    cab.arquivo[sizeof(cab.arquivo) - 1] = '\0';
+    int completo = ok && cab.soma == soma_verificacao(dados, cab.tamanho, soma_verificacao(&cab, offsetof(DiarioAntigo, soma), 2166136261u));
+    if (completo) {
+        FILE *f = fopen(cab.arquivo, "r+b");
+        ok = f != NULL && fseek(f, cab.deslocamento, SEEK_SET) == 0 &&
+             fwrite(dados, cab.tamanho, 1, f) == 1 && descarregar_arquivo(f);
+        if (f) fclose(f);
+        if (ok) printf("Diario recuperado: gravacao pendente em %s reaplicada.\n", cab.arquivo);
+        else printf("Aviso: nao foi possivel reaplicar o diario em %s.\n", cab.arquivo);
+    }
+    free(dados);
+    // incompleto: o arquivo de dados nao foi alterado
+    if (completo && !ok) return 0;
+    remove(ARQ_DIARIO);
+    return 1;
+}
+
+/* chamada no inicio (e antes de trocar um .dat inteiro): reaplica o diario
+   todo, porque depois de uma queda do sistema o que ja constava como
+   aplicado podia estar so no cache, e faz o checkpoint. o diario nunca passa
+   muito de DIARIO_LIMITE, entao isso e rapido com qualquer volume de dados */
+void recuperar_diario() {
+    if (!trava_byte(ARQ_DIARIO, 0, TRAVA_ESPERAR)) return;
+    CabecalhoDiario cab;
+    FILE *j = recuperar_diario_antigo() ? diario_abrir(&cab) : NULL;
+    if (j) {
+        long aplicado = cab.aplicado, fim = diario_reaplicar(j, sizeof(cab));
+        if (fim > aplicado) printf("Diario recuperado: transacoes pendentes reaplicadas.\n");
+        if (fim < 0 || !diario_checkpoint(j, &cab)) printf("Aviso: nao foi possivel reaplicar o diario.\n");
+        if (!modo_lote) fechar_aplicados();
+        diario_fechar(j);
+    }
+    trava_byte(ARQ_DIARIO, 0, TRAVA_SOLTAR);
+}
+
+//gravacao em lote (modo --lote e servidor com grupo)
+
+/* no modo lote cada comando continua sendo uma transacao do diario, mas o
+   commit grava o bloco sem fsync e os arquivos de dados ficam abertos o lote
+   inteiro. o fsync do diario e um so para o grupo de comandos (commit em
+   grupo: grupo_comandos comandos, ou o que vier antes de grupo_espera_ms no
+   servidor). se o programa cair no meio do grupo, cada comando ja aplicado
+   esta inteiro no diario; numa queda do sistema o que veio depois do ultimo
+   descarregamento pode se perder, e pela metade (--verificar-pontos refaz o
+   agregado de fidelidade). as travas soltas no meio do grupo so sao soltas
+   depois do fsync, entao nenhum outro processo le ou regrava algo que ainda
+   pode se perder. */
+#define LOTE_COMANDOS 1000
+
+int grupo_comandos = LOTE_COMANDOS; // comandos por descarregamento
+int grupo_espera_ms = 0;            // servidor: idade maxima do grupo (0 = sem limite)
+long grupo_pendentes = 0;           // comandos desde o ultimo descarregamento
+double grupo_inicio = 0;            // quando o primeiro deles terminou
+
+// fim de um grupo de comandos: um fsync do diario e so entao as travas adiadas sao soltas
+int lote_descarregar() {
+    int ok = diario_descarregar();
+    soltar_travas_adiadas();
+    grupo_pendentes = 0;
+    return ok;
+}
+
+/* conta um comando terminado no grupo; descarrega quando o grupo enche ou
+   se duravel (o chamador so responde depois do fsync). retorna 0 se o
+   descarregamento falhou */
+int lote_comando_feito(int duravel) {
+    if (grupo_pendentes++ == 0) grupo_inicio = agora_segundos();
+    if (!duravel && grupo_pendentes < grupo_comandos) return 1;
+    return lote_descarregar();
+}
+
+// grupo mais velho que grupo_espera_ms ja deve ir para o disco
+int lote_grupo_vencido() {
+    return grupo_pendentes > 0 && (agora_segundos() - grupo_inicio) * 1000.0 >= grupo_espera_ms;
+}
+
+int lote_encerrar() {
+    int ok = lote_descarregar();
+    if (!fechar_aplicados()) ok = 0;
+    if (diario_lote && fclose(diario_lote) != 0) ok = 0;
+    diario_lote = NULL;
+    modo_lote = 0;
+    return ok;
+}
+
+/* no lote ou dentro de uma transacao, travar um byte que ja e nosso
+   (adiado) so o retoma. no lote, antes de esperar por outro processo o
+   grupo e descarregado: nunca se espera segurando travas do grupo, senao
+   dois processos podem esperar um pelo outro. as da transacao aberta ficam;
+   entre transacoes a ordem das travas e sempre a mesma (estadias, fim de
+   estadias, fidelidade, quartos) */
+int travar_byte_lote(const char *arquivo, long byte) {
+    if (modo_lote || transacao.nivel > 0) {
+        ArquivoTrava *t = arquivo_trava(arquivo);
+        if (t && retomar_trava(t, byte)) return 1;
+    }
+    if (modo_lote) {
+        if (!trava_byte(arquivo, byte, TRAVA_TENTAR)) {
+            if (travas_adiadas_pendentes()) lote_descarregar();
+            if (!trava_byte(arquivo, byte, TRAVA_ESPERAR)) return 0;
+        }
+        conferir_aplicado(arquivo);
+        return 1;
+    }
+    return trava_byte(arquivo, byte, TRAVA_ESPERAR);
+}
+
+void destravar_byte_lote(const char *arquivo, long byte) {
+    int na_transacao = transacao.nivel > 0;
+    if (modo_lote || na_transacao) {
+        ArquivoTrava *t = arquivo_trava(arquivo);
+        if (t && adiar_trava(t, byte, na_transacao)) return;
+        if (modo_lote) lote_descarregar(); // lista cheia: o grupo vai para o disco agora
+        if (na_transacao && t && adiar_trava(t, byte, 1)) return;
+    }
+    trava_byte(arquivo, byte, TRAVA_SOLTAR);
+}
+
+int travar_anexo(const char *arquivo) { return travar_byte_lote(arquivo, 0); }
+void destravar_anexo(const char *arquivo) { destravar_byte_lote(arquivo, 0); }
+int travar_registro(const char *arquivo, long pos) { return travar_byte_lote(arquivo, pos + 1); }
+void destravar_registro(const char *arquivo, long pos) { destravar_byte_lote(arquivo, pos + 1); }
+
+// todos os registros de uma vez (compactacao); fora do modo lote
+int travar_todos_registros(const char *arquivo) { return trava_bytes(arquivo, 1, 0, TRAVA_ESPERAR); }
+void destravar_todos_registros(const char *arquivo) { trava_bytes(arquivo, 1, 0, TRAVA_SOLTAR); }
+
+// abre para leitura sequencial, ja depois do cabecalho. NULL se nao existe ou formato nao bate
+FILE *abrir_dados(const char *arquivo, size_t tam_registro, CabecalhoArquivo *cab) {
+    double t = agora_segundos();
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return NULL;
+    CabecalhoArquivo tmp;
+    if (!ler_cabecalho(f, arquivo, tam_registro, cab ? cab : &tmp)) { fclose(f); return NULL; }
+    medir(MED_ABRIR_DADOS, t);
+    return f;
+}
+
+//visao somente leitura do arquivo inteiro em memoria (relatorios)
+
+/* o arquivo e mapeado na memoria (mmap / MapViewOfFile) e os registros sao
+   lidos direto do mapa, sem fread nem copia por registro. como as structs
+   sao empacotadas, o mapa depois do cabecalho ja e um vetor de Cliente,
+   Quarto ou Estadia. se o mapeamento falhar o arquivo e lido inteiro com um
+   unico fread para um buffer, e o uso continua igual. */
+typedef struct {
+    const void *registros; // primeiro registro, logo depois do cabecalho
+    size_t quantidade;
+    void *base;            // inicio do mapa ou do buffer
+    size_t tamanho;        // bytes mapeados
+    int mapeado;           // 0 = buffer do malloc
+#ifdef _WIN32
+    HANDLE arquivo, mapa;
+#endif
+} VisaoArquivo;
+
+int visao_ler_buffer(VisaoArquivo *v, const char *arquivo) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return 0;
+    v->base = malloc(v->tamanho);
+    int ok = v->base != NULL && fread(v->base, 1, v->tamanho, f) == v->tamanho;
+    fclose(f);
+    if (!ok) { free(v->base); v->base = NULL; }
+    v->mapeado = 0;
+    return ok;
+}
+
+#ifdef _WIN32
+int visao_mapear(VisaoArquivo *v, const char *arquivo) {
+    v->arquivo = CreateFileA(arquivo, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (v->arquivo == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER tam;
+    if (!GetFileSizeEx(v->arquivo, &tam) || tam.QuadPart < (LONGLONG)sizeof(CabecalhoArquivo)) {
+        CloseHandle(v->arquivo); return 0;
+    }
+    v->tamanho = (size_t)tam.QuadPart;
+    v->mapa = CreateFileMappingA(v->arquivo, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (v->mapa) v->base = MapViewOfFile(v->mapa, FILE_MAP_READ, 0, 0, 0);
+    if (!v->base) {
+        if (v->mapa) CloseHandle(v->mapa);
+        CloseHandle(v->arquivo);
+        return visao_ler_buffer(v, arquivo);
+    }
+    v->mapeado = 1;
+    return 1;
+}
+#else
+int visao_mapear(VisaoArquivo *v, const char *arquivo) {
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CabecalhoArquivo)) { close(fd); return 0; }
+    v->tamanho = (size_t)st.st_size;
+    void *mapa = mmap(NULL, v->tamanho, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // o mapa continua valido sem o descritor
+    if (mapa == MAP_FAILED) return visao_ler_buffer(v, arquivo);
+    madvise(mapa, v->tamanho, MADV_SEQUENTIAL);
+    v->base = mapa;
+    v->mapeado = 1;
+    return 1;
+}
+#endif
+
+void fechar_visao(VisaoArquivo *v) {
+    if (!v->base) return;
+    if (!v->mapeado) {
+        free(v->base);
+    } else {
+#ifdef _WIN32
+        UnmapViewOfFile(v->base);
+        CloseHandle(v->mapa);
+        CloseHandle(v->arquivo);
+#else
+        munmap(v->base, v->tamanho);
+#endif
+    }
+    memset(v, 0, sizeof(*v));
+}
+
+// abre a visao e confere o cabecalho. retorna 0 se nao existe ou formato nao bate
+int abrir_visao(VisaoArquivo *v, const char *arquivo, size_t tam_registro) {
+    double t = agora_segundos();
+    memset(v, 0, sizeof(*v));
+    if (!visao_mapear(v, arquivo)) return 0;
+    if (!cabecalho_confere(v->base, arquivo, tam_registro)) { fechar_visao(v); return 0; }
+    v->registros = (const char *)v->base + sizeof(CabecalhoArquivo);
+    // vale o numero de registros inteiros, igual a ler_cabecalho
+    v->quantidade = (v->tamanho - sizeof(CabecalhoArquivo)) / tam_registro;
+    contar_lidos(v->quantidade);
+    medir(MED_ABRIR_VISAO, t);
+    return 1;
+}
+
+//indice em memoria (codigo/numero -> posicao do registro no arquivo)
+
+/* tabela hash de enderecamento aberto. a posicao guardada e o numero do
+   registro dentro do arquivo (0, 1, 2...), o deslocamento em bytes e
+   posicao * sizeof(registro). posicao -1 marca slot vazio. */
+typedef struct {
+    int chave;
+    long posicao;
+} EntradaIndice;
+
+typedef struct {
+    EntradaIndice *entradas;
+    size_t capacidade; // sempre potencia de 2
+    size_t quantidade; // chaves distintas inseridas
+    long registros;    // total de registros no arquivo (proxima posicao livre)
+    int proximo_codigo; // contador de codigos, espelho de CabecalhoArquivo.proximoCodigo
+} Indice;
+
+Indice idx_clientes, idx_funcionarios, idx_quartos, idx_estadias;
+
+size_t hash_chave(int chave, size_t capacidade) {
+    unsigned int h = (unsigned int)chave * 2654435761u;
+    return (size_t)h & (capacidade - 1);
+}
+
+// retorna a posicao do registro com essa chave ou -1 se nao existe
+long indice_buscar(const Indice *idx, int chave) {
+    if (idx->capacidade == 0) return -1;
+    size_t i = hash_chave(chave, idx->capacidade);
+    while (idx->entradas[i].posicao != -1) {
+        if (idx->entradas[i].chave == chave) return idx->entradas[i].posicao;
+        i = (i + 1) & (idx->capacidade - 1);
+    }
+    return -1;
+}
+
+int indice_crescer(Indice *idx) {
+    size_t nova_cap = idx->capacidade ? idx->capacidade * 2 : 64;
+    EntradaIndice *novas = malloc(nova_cap * sizeof(EntradaIndice));
+    if (!novas) return 0;
+    for (size_t i = 0; i < nova_cap; ++i) novas[i].posicao = -1;
+    for (size_t i = 0; i < idx->capacidade; ++i) {
+        if (idx->entradas[i].posicao == -1) continue;
+        size_t j = hash_chave(idx->entradas[i].chave, nova_cap);
+        while (novas[j].posicao != -1) j = (j + 1) & (nova_cap - 1);
+        novas[j] = idx->entradas[i];
+    }
+    free(idx->entradas);
+    idx->entradas = novas;
+    idx->capacidade = nova_cap;
+    return 1;
+}
+
+// insere ou atualiza a posicao de uma chave
+int indice_inserir(Indice *idx, int chave, long posicao) {
+    // mantem ocupacao abaixo de 70%
+    if ((idx->quantidade + 1) * 10 > idx->capacidade * 7) {
+        if (!indice_crescer(idx)) return 0;
+    }
+    size_t i = hash_chave(chave, idx->capacidade);
+    while (idx->entradas[i].posicao != -1) {
+        if (idx->entradas[i].chave == chave) {
+            idx->entradas[i].posicao = posicao;
+            return 1;
+        }
+        i = (i + 1) & (idx->capacidade - 1);
+    }
+    idx->entradas[i].chave = chave;
+    idx->entradas[i].posicao = posicao;
+    idx->quantidade++;
+    return 1;
+}
+
+void indice_liberar(Indice *idx) {
+    free(idx->entradas);
+    memset(idx, 0, sizeof(*idx));
+}
+
+typedef void (*AcaoRegistro)(const void *reg, long pos, void *ctx);
+
+/* le em blocos os registros que o arquivo tem depois de idx->registros e
+   indexa pelo primeiro campo int (todas as structs comecam pelo codigo ou
+   numero); novo, se nao for NULL, e chamado para cada um. serve para a
+   carga inicial e para alcancar o que outro terminal anexou.
+   se houver chave repetida vale a primeira, igual a busca sequencial antiga.
+   o contador de codigos vem do cabecalho; arquivos convertidos (contador 0)
+   ou com cabecalho atrasado por queda ficam com o maior codigo + 1 */
+void indice_ler_cauda(Indice *idx, const char *arquivo, size_t tam_registro, AcaoRegistro novo) {
+    double t = agora_segundos();
+    CabecalhoArquivo cab;
+    FILE *f = abrir_dados(arquivo, tam_registro, &cab);
+    if (!f) return;
+    if (cab.proximoCodigo > idx->proximo_codigo) idx->proximo_codigo = cab.proximoCodigo;
+    if (idx->proximo_codigo <= 0) idx->proximo_codigo = 1;
+    if ((long)cab.quantidade <= idx->registros ||
+        fseek(f, deslocamento_registro(idx->registros, tam_registro), SEEK_SET) != 0) { fclose(f); return; }
+    size_t lote = 4096;
+    char *buf = malloc(lote * tam_registro);
+    if (!buf) { fclose(f); return; }
+    size_t lidos, faltam = cab.quantidade - (size_t)idx->registros;
+    while (faltam > 0 && (lidos = fread(buf, tam_registro, faltam < lote ? faltam : lote, f)) > 0) {
+        faltam -= lidos;
+        contar_lidos(lidos);
+        for (size_t i = 0; i < lidos; ++i) {
+            int chave;
+            memcpy(&chave, buf + i * tam_registro, sizeof(int));
+            if (indice_buscar(idx, chave) < 0) indice_inserir(idx, chave, idx->registros);
+            if (chave >= idx->proximo_codigo) idx->proximo_codigo = chave + 1;
+            if (novo) novo(buf + i * tam_registro, idx->registros, NULL);
+            idx->registros++;
+        }
+    }
+    free(buf);
+    fclose(f);
+    medir(MED_LER_CAUDA, t);
+}
+
+void indice_carregar(Indice *idx, const char *arquivo, size_t tam_registro) {
+    indice_liberar(idx);
+    indice_ler_cauda(idx, arquivo, tam_registro, NULL);
+}
+
+void carregar_indices() {
+    indice_carregar(&idx_clientes, ARQ_CLIENTES, sizeof(Cliente));
+    indice_carregar(&idx_funcionarios, ARQ_FUNCIONARIOS, sizeof(Funcionario));
+    indice_carregar(&idx_quartos, ARQ_QUARTOS, sizeof(Quarto));
+    indice_carregar(&idx_estadias, ARQ_ESTADIAS, sizeof(Estadia));
+}
+
+void liberar_indices() {
+    indice_liberar(&idx_clientes);
+    indice_liberar(&idx_funcionarios);
+    indice_liberar(&idx_quartos);
+    indice_liberar(&idx_estadias);
+}
+
+// le o registro na posicao pos (numero do registro, nao bytes). retorna 1 se leu
+int ler_registro(const char *arquivo, size_t tam_registro, long pos, void *destino) {
+    if (pos < 0) return 0;
+    double t = agora_segundos();
+    long deslocamento = deslocamento_registro(pos, tam_registro);
+    FILE *f = fopen(arquivo, "rb");
+    int ok = f != NULL && fseek(f, deslocamento, SEEK_SET) == 0 && fread(destino, tam_registro, 1, f) == 1;
+    if (f) fclose(f);
+    // o que a transacao aberta ja gravou ainda nao esta no arquivo
+    if (transacao.nivel > 0 && transacao_sobrepor(arquivo, deslocamento, destino, tam_registro)) ok = 1;
+    if (ok) { contar_lidos(1); medir(MED_LER_REGISTRO, t); }
+    return ok;
+}
+
+/* cabecalho como esta no arquivo, com o que a transacao aberta ja mudou
+   nele; novo se o arquivo ainda nao existe. retorna 0 se o formato nao bate */
+int cabecalho_atual(const char *arquivo, size_t tam_registro, CabecalhoArquivo *cab) {
+    FILE *f = fopen(arquivo, "rb");
+    if (f) {
+        int ok = ler_cabecalho(f, arquivo, tam_registro, cab);
+        fclose(f);
+        if (!ok) return 0;
+    } else {
+        novo_cabecalho(cab, arquivo, tam_registro);
+    }
+    if (transacao.nivel > 0) transacao_sobrepor(arquivo, 0, cab, sizeof(*cab));
+    return 1;
+}
+
+/* grava n registros seguidos depois do ultimo, atualiza a quantidade e o
+   contador de codigos no cabecalho (na mesma transacao) e ja registra as
+   chaves (primeiro int) no indice. cria o arquivo se nao existe */
+int anexar_registros(Indice *idx, const char *arquivo, const void *regs, size_t n, size_t tam_registro) {
+    double t = agora_segundos();
+    CabecalhoArquivo cab;
+    if (!cabecalho_atual(arquivo, tam_registro, &cab)) return 0;
+    const char *bytes = regs;
+    long pos = (long)cab.quantidade;
+    cab.quantidade += (uint32_t)n;
+    if (cab.proximoCodigo < idx->proximo_codigo) cab.proximoCodigo = idx->proximo_codigo;
+    for (size_t i = 0; i < n; ++i) {
+        int chave;
+        memcpy(&chave, bytes + i * tam_registro, sizeof(int));
+        if (chave >= cab.proximoCodigo) cab.proximoCodigo = chave + 1;
+    }
+    transacao_iniciar();
+    if (!transacao_gravar(arquivo, deslocamento_registro(pos, tam_registro), regs, n * tam_registro) ||
+        !transacao_gravar(arquivo, 0, &cab, sizeof(cab))) {
+        transacao_descartar();
+        return 0;
+    }
+    if (!transacao_confirmar()) return 0;
+    for (size_t i = 0; i < n; ++i) {
+        int chave;
+        memcpy(&chave, bytes + i * tam_registro, sizeof(int));
+        if (indice_buscar(idx, chave) < 0) indice_inserir(idx, chave, pos + (long)i);
+    }
+    idx->registros = pos + (long)n;
+    idx->proximo_codigo = cab.proximoCodigo;
+    medir(MED_ANEXAR, t);
+    return 1;
+}
+
+int anexar_registro(Indice *idx, const char *arquivo, const void *reg, size_t tam_registro) {
+    return anexar_registros(idx, arquivo, reg, 1, tam_registro);
+}
+
+// sobrescreve o registro na posicao pos (pelo diario, na transacao aberta se houver)
+int gravar_registro(const char *arquivo, const void *reg, size_t tam_registro, long pos) {
+    double t = agora_segundos();
+    int ok = transacao_gravar(arquivo, deslocamento_registro(pos, tam_registro), reg, tam_registro);
+    if (ok) medir(MED_GRAVAR_REGISTRO, t);
+    return ok;
+}
+
+/* anexar_registros com as insercoes publicadas no log de alteracoes, na
+   mesma transacao. se o commit falha o indice e lido de novo do arquivo */
+int anexar_publicando(TipoAlteracao tipo, Indice *idx, const char *arquivo, const void *regs, size_t n, size_t tam_registro) {
+    int sozinha = transacao.nivel == 0;
+    transacao_iniciar();
+    for (size_t i = 0; i < n; ++i)
+        publicar_alteracao(tipo, ALT_INSERCAO, (const char *)regs + i * tam_registro, tam_registro);
+    if (!anexar_registros(idx, arquivo, regs, n, tam_registro)) {
+        transacao_descartar();
+        return 0;
+    }
+    if (transacao_confirmar()) return 1;
+    if (sozinha) indice_carregar(idx, arquivo, tam_registro);
+    return 0;
+}
+
+// gravar_registro com a atualizacao publicada no log de alteracoes
+int gravar_publicando(TipoAlteracao tipo, const char *arquivo, const void *reg, size_t tam_registro, long pos) {
+    transacao_iniciar();
+    publicar_alteracao(tipo, ALT_ATUALIZACAO, reg, tam_registro);
+    if (!gravar_registro(arquivo, reg, tam_registro, pos)) {
+        transacao_descartar();
+        return 0;
+    }
+    return transacao_confirmar();
+}
+
+//conversao dos arquivos antigos (sem cabecalho) para o formato versionado
+
+/* layouts como eram gravados antes do cabecalho: fwrite direto da struct,
+   com o alinhamento normal do compilador */
+typedef struct {
+    int codigo;
+    char nome[80];
+    char endereco[120];
+    char telefone[20];
+} ClienteAntigo;
+
+typedef struct {
+    int codigo;
+    char nome[80];
+    char telefone[20];
+    char cargo[30];
+    float salario;
+} FuncionarioAntigo;
+
+typedef struct {
+    int numero;
+    int qtdHospedes;
+    float valorDiaria;
+    int ocupado;
+} QuartoAntigo;
+
+// primeira versao de estadia, com datas em texto AAAAMMDD
+typedef struct {
+    int codigo;
+    char dataEntrada[9];
+    char dataSaida[9];
+    int qtdDiarias;
+    int codCliente;
+    int numeroQuarto;
+    int ativo;
+} EstadiaAntigaTexto;
+
+// estadia com datas numericas, ainda sem cabecalho
+typedef struct {
+    int codigo;
+    Data dataEntrada;
+    Data dataSaida;
+    int qtdDiarias;
+    int codCliente;
+    int numeroQuarto;
+    int ativo;
+} EstadiaAntiga;
+
+void converter_cliente(const void *antigo, void *novo) {
+    const ClienteAntigo *a = antigo;
+    Cliente *c = novo;
+    c->codigo = a->codigo;
+    memcpy(c->nome, a->nome, sizeof(c->nome));
+    memcpy(c->endereco, a->endereco, sizeof(c->endereco));
+    memcpy(c->telefone, a->telefone, sizeof(c->telefone));
+}
+
+void converter_funcionario(const void *antigo, void *novo) {
+    const FuncionarioAntigo *a = antigo;
+    Funcionario *p = novo;
+    p->codigo = a->codigo;
+    memcpy(p->nome, a->nome, sizeof(p->nome));
+    memcpy(p->telefone, a->telefone, sizeof(p->telefone));
+    memcpy(p->cargo, a->cargo, sizeof(p->cargo));
+    p->salario = a->salario;
+}
+
+void converter_quarto(const void *antigo, void *novo) {
+    const QuartoAntigo *a = antigo;
+    Quarto *q = novo;
+    q->numero = a->numero;
+    q->qtdHospedes = (int16_t)a->qtdHospedes;
+    q->valorDiaria = a->valorDiaria;
+    q->ocupado = (uint8_t)(a->ocupado != 0);
+}
+
+void converter_estadia(const void *antigo, void *novo) {
+    const EstadiaAntiga *a = antigo;
+    Estadia *e = novo;
+    e->codigo = a->codigo;
+    e->dataEntrada = a->dataEntrada;
+    e->dataSaida = a->dataSaida;
+    e->qtdDiarias = (int16_t)a->qtdDiarias;
+    e->codCliente = a->codCliente;
+    e->numeroQuarto = a->numeroQuarto;
+    e->ativo = (uint8_t)a->ativo;
+}
+
+Data data_de_texto(const char *aaaammdd) {
+    int a, m, d;
+    if (sscanf(aaaammdd, "%4d%2d%2d", &a, &m, &d) != 3) return 0;
+    return data_de_civil(a, m, d);
+}
+
+/* estadias finalizadas mantem a qtdDiarias que foi cobrada; as ativas
+   tem a qtdDiarias recalculada, porque a conta antiga (meses de 30 dias)
+   errava na virada do mes */
+void converter_estadia_texto(const void *antigo, void *novo) {
+    EstadiaAntigaTexto a = *(const EstadiaAntigaTexto *)antigo;
+    Estadia *e = novo;
+    a.dataEntrada[8] = a.dataSaida[8] = '\0';
+    e->codigo = a.codigo;
+    e->dataEntrada = data_de_texto(a.dataEntrada);
+    e->dataSaida = data_de_texto(a.dataSaida);
+    e->qtdDiarias = (int16_t)a.qtdDiarias;
+    if (a.ativo == 1 && diff_days(e->dataEntrada, e->dataSaida) > 0)
+        e->qtdDiarias = (int16_t)diff_days(e->dataEntrada, e->dataSaida);
+    e->codCliente = a.codCliente;
+    e->numeroQuarto = a.numeroQuarto;
+    e->ativo = (uint8_t)a.ativo;
+}
+
+/* o layout com datas em texto tem 8 digitos e um '\0' logo depois do codigo;
+   no layout numerico esses bytes sao o numero do dia, que nunca forma texto */
+int estadia_layout_texto(const unsigned char *reg) {
+    for (int i = 4; i < 12; ++i) if (reg[i] < '0' || reg[i] > '9') return 0;
+    return reg[12] == '\0';
+}
+
+/* reescreve um arquivo sem cabecalho no formato novo. o novo e escrito ao
+   lado (.novo) e so depois renomeado; o antigo fica em .bak */
+int converter_arquivo(const char *arquivo, size_t tam_antigo, size_t tam_novo,
+                      void (*converter)(const void *antigo, void *novo)) {
+    char novo_nome[64], bak_nome[64];
+    snprintf(novo_nome, sizeof(novo_nome), "%s.novo", arquivo);
+    snprintf(bak_nome, sizeof(bak_nome), "%s.bak", arquivo);
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return 0;
+    FILE *fn = fopen(novo_nome, "wb");
+    if (!fn) { fclose(f); perror("Erro ao converter arquivo"); return 0; }
+
+    CabecalhoArquivo cab;
+    novo_cabecalho(&cab, arquivo, tam_novo);
+    int ok = fwrite(&cab, sizeof(cab), 1, fn) == 1;
+    unsigned char antigo[64], novo[256];
+    while (ok && fread(antigo, tam_antigo, 1, f) == 1) {
+        memset(novo, 0, tam_novo);
+        converter(antigo, novo);
+        ok = fwrite(novo, tam_novo, 1, fn) == 1;
+        cab.quantidade++;
+    }
+    fclose(f);
+    ok = ok && fseek(fn, 0, SEEK_SET) == 0 && fwrite(&cab, sizeof(cab), 1, fn) == 1 && descarregar_arquivo(fn);
+    if (fclose(fn) != 0) ok = 0;
+    remove(bak_nome);
+    if (!ok || rename(arquivo, bak_nome) != 0 || rename(novo_nome, arquivo) != 0) {
+        perror("Erro ao converter arquivo");
+        return 0;
+    }
+    printf("%s convertido para o formato versao %d (%u registros, copia em %s).\n",
+           arquivo, FORMATO_VERSAO, (unsigned)cab.quantidade, bak_nome);
+    return 1;
+}
+
+/* confere os quatro arquivos e converte os que ainda estao sem cabecalho.
+   roda no inicio do programa e tambem com --converter */
+void converter_arquivos() {
+    struct {
+        const char *arquivo;
+        size_t tam_antigo, tam_novo;
+        void (*converter)(const void *antigo, void *novo);
+    } tabela[] = {
+        { ARQ_CLIENTES, sizeof(ClienteAntigo), sizeof(Cliente), converter_cliente },
+        { ARQ_FUNCIONARIOS, sizeof(FuncionarioAntigo), sizeof(Funcionario), converter_funcionario },
+        { ARQ_QUARTOS, sizeof(QuartoAntigo), sizeof(Quarto), converter_quarto },
+        { ARQ_ESTADIAS, sizeof(EstadiaAntiga), sizeof(Estadia), converter_estadia },
+    };
+    for (size_t i = 0; i < sizeof(tabela) / sizeof(tabela[0]); ++i) {
+        FILE *f = fopen(tabela[i].arquivo, "rb");
+        if (!f) continue;
+        unsigned char inicio[sizeof(EstadiaAntigaTexto)];
+        size_t lidos = fread(inicio, 1, sizeof(inicio), f);
+        fclose(f);
+        if (lidos == 0) continue; // arquivo vazio: o cabecalho nasce no primeiro cadastro
+        if (lidos >= 4 && memcmp(inicio, magia_do_arquivo(tabela[i].arquivo), 4) == 0) continue;
+
+        if (strcmp(tabela[i].arquivo, ARQ_ESTADIAS) == 0 &&
+            lidos == sizeof(EstadiaAntigaTexto) && estadia_layout_texto(inicio)) {
+            tabela[i].tam_antigo = sizeof(EstadiaAntigaTexto);
+            tabela[i].converter = converter_estadia_texto;
+        }
+        converter_arquivo(tabela[i].arquivo, tabela[i].tam_antigo, tabela[i].tam_novo, tabela[i].converter);
+    }
+}
+
+/* gera codigo automatico sem ler o arquivo: o contador fica no cabecalho
+   (proximoCodigo) e em memoria no indice. so avanca quando o registro e
+   gravado por anexar_registro, entao um cadastro cancelado nao gasta codigo */
+int proximo_codigo_livre(const Indice *idx) {
+    int cod = idx->proximo_codigo > 0 ? idx->proximo_codigo : 1;
+    while (indice_buscar(idx, cod) >= 0) cod++;
+    return cod;
+}
+
+/* reserva n codigos seguidos para uma importacao em lote e ja grava o
+   contador avancado no cabecalho, entao nenhum cadastro normal reaproveita
+   esses codigos nem depois de reiniciar. retorna o primeiro ou -1 */
+int reservar_codigos(Indice *idx, const char *arquivo, size_t tam_registro, int n) {
+    if (n <= 0) return -1;
+    CabecalhoArquivo cab;
+    if (!cabecalho_atual(arquivo, tam_registro, &cab)) return -1;
+    int primeiro = proximo_codigo_livre(idx);
+    if (cab.proximoCodigo > primeiro) primeiro = cab.proximoCodigo;
+    cab.proximoCodigo = primeiro + n;
+    if (!transacao_gravar(arquivo, 0, &cab, sizeof(cab))) return -1;
+    idx->proximo_codigo = cab.proximoCodigo;
+    return primeiro;
+}
+
+int gerar_codigo_cliente() {
+    return proximo_codigo_livre(&idx_clientes);
+}
+int gerar_codigo_funcionario() {
+    return proximo_codigo_livre(&idx_funcionarios);
+}
+int gerar_codigo_estadia() {
+    return proximo_codigo_livre(&idx_estadias);
+}
+
+//fios (threads) de trabalho
+
+#ifdef _WIN32
+typedef HANDLE Fio;
+#define FIO_RETORNO DWORD WINAPI
+#else
+typedef pthread_t Fio;
+#define FIO_RETORNO void *
+#endif
+typedef FIO_RETORNO (*FuncaoFio)(void *arg);
+
+int iniciar_fio(Fio *fio, FuncaoFio funcao, void *arg) {
+#ifdef _WIN32
+    *fio = CreateThread(NULL, 0, funcao, arg, 0, NULL);
+    return *fio != NULL;
+#else
+    return pthread_create(fio, NULL, funcao, arg) == 0;
+#endif
+}
+
+void esperar_fio(Fio fio) {
+#ifdef _WIN32
+    WaitForSingleObject(fio, INFINITE);
+    CloseHandle(fio);
+#else
+    pthread_join(fio, NULL);
+#endif
+}
+
+int numero_de_nucleos() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int n = (int)info.dwNumberOfProcessors;
+#else
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? n : 1;
+}
+
+//varredura paralela em pedacos
+
+/* um trabalho dividido em pedacos independentes (faixas de registros
+   inteiros, um mes arquivado...) roda em ate numero_de_nucleos() fios. cada
+   fio comeca com uma faixa seguida de pedacos e tira do comeco dela; quando
+   a sua acaba, rouba o ultimo pedaco da faixa de outro fio (roubo de
+   trabalho), entao um pedaco lento nao deixa os outros fios parados. cada
+   faixa e um inteiro de 64 bits (inicio << 32 | fim) trocado com
+   compare-and-swap, sem mutex. quem chama tambem trabalha, e o resultado de
+   cada pedaco fica separado para ser juntado em ordem depois. */
+#define VARREDURA_MAX_FIOS 64
+
+typedef void (*TrabalhoPedaco)(size_t pedaco, void *ctx);
+
+typedef struct {
+    volatile uint64_t faixa; // pedacos [inicio, fim) que ainda sao deste fio
+    char folga[56];          // uma linha de cache por fio
+} FaixaFio;
+
+typedef struct {
+    FaixaFio faixas[VARREDURA_MAX_FIOS];
+    int fios;
+    TrabalhoPedaco trabalho;
+    void *ctx;
+} Varredura;
+
+typedef struct {
+    Varredura *v;
+    int eu;
+} FioVarredura;
+
+int trocar_faixa(volatile uint64_t *faixa, uint64_t antes, uint64_t depois) {
+#ifdef _WIN32
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)faixa, (LONG64)depois, (LONG64)antes) == antes;
+#else
+    return __atomic_compare_exchange_n(faixa, &antes, depois, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// tira um pedaco do comeco (dono) ou do fim (quem rouba). -1 se a faixa esta vazia
+long tirar_pedaco(FaixaFio *f, int do_fim) {
+    for (;;) {
+#ifdef _WIN32
+        uint64_t v = (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)&f->faixa, 0, 0);
+#else
+        uint64_t v = __atomic_load_n(&f->faixa, __ATOMIC_ACQUIRE);
+#endif
+        uint32_t inicio = (uint32_t)(v >> 32), fim = (uint32_t)v;
+        if (inicio >= fim) return -1;
+        uint64_t novo = do_fim ? ((uint64_t)inicio << 32 | (fim - 1)) : ((uint64_t)(inicio + 1) << 32 | fim);
+        if (trocar_faixa(&f->faixa, v, novo)) return do_fim ? (long)fim - 1 : (long)inicio;
+    }
+}
+
+FIO_RETORNO trabalhar_varredura(void *arg) {
+    FioVarredura *fv = arg;
+    Varredura *v = fv->v;
+    for (;;) {
+        long k = tirar_pedaco(&v->faixas[fv->eu], 0);
+        // a propria faixa acabou: rouba dos outros, a partir do vizinho
+        for (int i = 1; k < 0 && i < v->fios; ++i) k = tirar_pedaco(&v->faixas[(fv->eu + i) % v->fios], 1);
+        if (k < 0) break; // nenhum pedaco sobrando (ninguem cria pedaco novo)
+        v->trabalho((size_t)k, v->ctx);
+    }
+    return 0;
+}
+
+/* roda trabalho(k, ctx) para k de 0 a pedacos - 1, em paralelo. trabalho
+   so pode mexer no resultado do proprio pedaco */
+void varrer_em_paralelo(size_t pedacos, TrabalhoPedaco trabalho, void *ctx) {
+    int fios = numero_de_nucleos();
+    if (fios > VARREDURA_MAX_FIOS) fios = VARREDURA_MAX_FIOS;
+    if ((size_t)fios > pedacos) fios = (int)pedacos;
+    if (fios <= 1) {
+        for (size_t k = 0; k < pedacos; ++k) trabalho(k, ctx);
+        return;
+    }
+    Varredura *v = malloc(sizeof(Varredura));
+    if (!v) {
+        for (size_t k = 0; k < pedacos; ++k) trabalho(k, ctx);
+        return;
+    }
+    v->fios = fios;
+    v->trabalho = trabalho;
+    v->ctx = ctx;
+    FioVarredura args[VARREDURA_MAX_FIOS];
+    Fio ids[VARREDURA_MAX_FIOS];
+    int iniciado[VARREDURA_MAX_FIOS];
+    for (int i = 0; i < fios; ++i) {
+        uint64_t inicio = pedacos * (size_t)i / (size_t)fios, fim = pedacos * (size_t)(i + 1) / (size_t)fios;
+        v->faixas[i].faixa = inicio << 32 | fim;
+        args[i].v = v;
+        args[i].eu = i;
+    }
+    // se um fio nao iniciar, a faixa dele e roubada pelos outros
+    for (int i = 1; i < fios; ++i) iniciado[i] = iniciar_fio(&ids[i], trabalhar_varredura, &args[i]);
+    trabalhar_varredura(&args[0]);
+    for (int i = 1; i < fios; ++i)
+        if (iniciado[i]) esperar_fio(ids[i]);
+    free(v);
+}
+
+//indice de trigramas para busca por nome
+
+/* cada nome e normalizado (minusculas, sem acento) e quebrado em trigramas,
+   sequencias de 3 bytes. para cada trigrama ha uma lista crescente das
+   posicoes dos registros que o contem. a busca por "aria" so olha os
+   registros que estao nas listas de "ari" e "ria" ao mesmo tempo, e cada
+   candidato ainda e conferido com strstr no nome normalizado. o indice e
+   atualizado a cada cadastro e gravado em .tri ao sair; registros que
+   entraram depois da ultima gravacao sao indexados na abertura. */
+typedef struct {
+    char magia[4];       // "HDGT"
+    uint16_t versao;
+    uint16_t reservado;
+    uint32_t registros;  // registros do .dat ja indexados
+    uint32_t listas;
+    uint32_t soma;       // FNV-1a das listas gravadas depois do cabecalho
+} CabecalhoTrigramas;
+
+_Static_assert(sizeof(CabecalhoTrigramas) == 20, "cabecalho de trigramas deve ter 20 bytes");
+
+typedef struct {
+    int32_t trigrama;
+    uint32_t *posicoes;
+    size_t qtd, cap;
+} ListaTrigrama;
+
+typedef struct {
+    const char *arquivo;     // .dat indexado
+    const char *arquivo_tri;
+    size_t tam_registro;
+    size_t desloc_nome;      // offsetof do campo nome
+    Indice mapa;             // trigrama -> posicao em listas[]
+    ListaTrigrama *listas;
+    size_t qtd_listas, cap_listas;
+    long registros;
+    int alterado;            // precisa gravar o .tri ao sair
+} IndiceTexto;
+
+IndiceTexto txt_clientes = { ARQ_CLIENTES, ARQ_TRI_CLIENTES, sizeof(Cliente), offsetof(Cliente, nome) };
+IndiceTexto txt_funcionarios = { ARQ_FUNCIONARIOS, ARQ_TRI_FUNCIONARIOS, sizeof(Funcionario), offsetof(Funcionario, nome) };
+
+#define TAM_NOME 80
+
+/* minusculas e sem acento. aceita latin-1 (console do windows) e utf-8
+   (so a faixa C3 xx, que cobre as letras acentuadas do portugues) */
+size_t dobrar_texto(const char *in, size_t max_in, char *out, size_t tam_out) {
+    // letras de 0xC0 a 0xDF; as de 0xE0 a 0xFF sao as mesmas em minuscula
+    static const char sem_acento[] = "aaaaaaaceeeeiiiidnooooo ouuuuyts";
+    const unsigned char *p = (const unsigned char *)in;
+    size_t n = 0;
+    for (size_t i = 0; i < max_in && p[i] != '\0' && n + 1 < tam_out; ++i) {
+        unsigned int c = p[i];
+        if (c == 0xC3 && i + 1 < max_in && p[i + 1] >= 0x80 && p[i + 1] <= 0xBF) c = p[++i] + 0x40;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        else if (c == 0xFF) c = 'y';
+        else if (c >= 0xC0) c = (unsigned char)sem_acento[c & 0x1F];
+        out[n++] = (char)c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+int32_t trigrama_em(const char *s) {
+    const unsigned char *p = (const unsigned char *)s;
+    return (int32_t)((p[0] << 16) | (p[1] << 8) | p[2]);
+}
+
+ListaTrigrama *texto_lista(IndiceTexto *t, int32_t trigrama, int criar) {
+    long pos = indice_buscar(&t->mapa, trigrama);
+    if (pos >= 0) return &t->listas[pos];
+    if (!criar) return NULL;
+    if (t->qtd_listas == t->cap_listas) {
+        size_t nova_cap = t->cap_listas ? t->cap_listas * 2 : 256;
+        ListaTrigrama *novas = realloc(t->listas, nova_cap * sizeof(ListaTrigrama));
+        if (!novas) return NULL;
+        t->listas = novas; t->cap_listas = nova_cap;
+    }
+    ListaTrigrama *l = &t->listas[t->qtd_listas];
+    memset(l, 0, sizeof(*l));
+    l->trigrama = trigrama;
+    indice_inserir(&t->mapa, trigrama, (long)t->qtd_listas);
+    t->qtd_listas++;
+    return l;
+}
+
+// registros sao indexados em ordem, entao a lista continua crescente
+void texto_indexar(IndiceTexto *t, const char *nome, long pos) {
+    char dobrado[TAM_NOME + 1];
+    size_t n = dobrar_texto(nome, TAM_NOME, dobrado, sizeof(dobrado));
+    for (size_t i = 0; i + 3 <= n; ++i) {
+        ListaTrigrama *l = texto_lista(t, trigrama_em(dobrado + i), 1);
+        if (!l) return;
+        if (l->qtd > 0 && l->posicoes[l->qtd - 1] == (uint32_t)pos) continue; // trigrama repetido no nome
+        if (l->qtd == l->cap) {
+            size_t nova_cap = l->cap ? l->cap * 2 : 4;
+            uint32_t *novas = realloc(l->posicoes, nova_cap * sizeof(uint32_t));
+            if (!novas) return;
+            l->posicoes = novas; l->cap = nova_cap;
+        }
+        l->posicoes[l->qtd++] = (uint32_t)pos;
+    }
+    if (pos + 1 > t->registros) t->registros = pos + 1;
+    t->alterado = 1;
+}
+
+void texto_liberar(IndiceTexto *t) {
+    for (size_t i = 0; i < t->qtd_listas; ++i) free(t->listas[i].posicoes);
+    free(t->listas);
+    t->listas = NULL; t->qtd_listas = t->cap_listas = 0;
+    t->registros = 0; t->alterado = 0;
+    indice_liberar(&t->mapa);
+}
+
+// le o .tri; qualquer problema (ausente, corrompido, maior que o .dat) descarta tudo
+int texto_ler(IndiceTexto *t, size_t registros_dat) {
+    FILE *f = fopen(t->arquivo_tri, "rb");
+    if (!f) return 0;
+    CabecalhoTrigramas cab;
+    int ok = fread(&cab, sizeof(cab), 1, f) == 1 && memcmp(cab.magia, "HDGT", 4) == 0 &&
+             cab.versao == FORMATO_VERSAO && cab.registros <= registros_dat;
+    unsigned int soma = 2166136261u;
+    for (uint32_t i = 0; ok && i < cab.listas; ++i) {
+        int32_t trigrama; uint32_t qtd;
+        ok = fread(&trigrama, sizeof(trigrama), 1, f) == 1 && fread(&qtd, sizeof(qtd), 1, f) == 1 &&
+             qtd <= cab.registros;
+        ListaTrigrama *l = ok ? texto_lista(t, trigrama, 1) : NULL;
+        ok = l != NULL && l->qtd == 0 && (qtd == 0 || (l->posicoes = malloc(qtd * sizeof(uint32_t))) != NULL) &&
+             fread(l->posicoes, sizeof(uint32_t), qtd, f) == qtd;
+        if (!ok) break;
+        l->qtd = l->cap = qtd;
+        soma = soma_verificacao(&trigrama, sizeof(trigrama), soma);
+        soma = soma_verificacao(&qtd, sizeof(qtd), soma);
+        soma = soma_verificacao(l->posicoes, qtd * sizeof(uint32_t), soma);
+    }
+    fclose(f);
+    if (!ok || soma != cab.soma) { texto_liberar(t); return 0; }
+    t->registros = cab.registros;
+    return 1;
+}
+
+// grava ao lado (.novo) e renomeia, como na conversao dos .dat
+int texto_salvar(IndiceTexto *t) {
+    if (!t->alterado) return 1;
+    char novo_nome[64];
+    snprintf(novo_nome, sizeof(novo_nome), "%s.novo", t->arquivo_tri);
+    FILE *f = fopen(novo_nome, "wb");
+    if (!f) return 0;
+    CabecalhoTrigramas cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magia, "HDGT", 4);
+    cab.versao = FORMATO_VERSAO;
+    cab.registros = (uint32_t)t->registros;
+    cab.listas = (uint32_t)t->qtd_listas;
+    cab.soma = 2166136261u;
+    int ok = fwrite(&cab, sizeof(cab), 1, f) == 1;
+    for (size_t i = 0; ok && i < t->qtd_listas; ++i) {
+        const ListaTrigrama *l = &t->listas[i];
+        uint32_t qtd = (uint32_t)l->qtd;
+        ok = fwrite(&l->trigrama, sizeof(l->trigrama), 1, f) == 1 && fwrite(&qtd, sizeof(qtd), 1, f) == 1 &&
+             fwrite(l->posicoes, sizeof(uint32_t), qtd, f) == qtd;
+        cab.soma = soma_verificacao(&l->trigrama, sizeof(l->trigrama), cab.soma);
+        cab.soma = soma_verificacao(&qtd, sizeof(qtd), cab.soma);
+        cab.soma = soma_verificacao(l->posicoes, qtd * sizeof(uint32_t), cab.soma);
+    }
+    long gravados = ftell(f);
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&cab, sizeof(cab), 1, f) == 1 && descarregar_arquivo(f);
+    if (fclose(f) != 0) ok = 0;
+    remove(t->arquivo_tri);
+    if (!ok || rename(novo_nome, t->arquivo_tri) != 0) { remove(novo_nome); return 0; }
+    if (gravados > 0) med_bytes_gravados += (unsigned long long)gravados;
+    t->alterado = 0;
+    return 1;
+}
+
+// carrega o .tri e indexa os registros que o .dat tem a mais
+void texto_carregar(IndiceTexto *t) {
+    texto_liberar(t);
+    VisaoArquivo v;
+    if (!abrir_visao(&v, t->arquivo, t->tam_registro)) return;
+    texto_ler(t, v.quantidade);
+    const char *regs = v.registros;
+    for (size_t i = (size_t)t->registros; i < v.quantidade; ++i)
+        texto_indexar(t, regs + i * t->tam_registro + t->desloc_nome, (long)i);
+    fechar_visao(&v);
+}
+
+/* candidatos conferidos em pedacos de VARREDURA_NOMES, em paralelo; os
+   achados de cada pedaco saem na ordem das posicoes */
+#define VARREDURA_NOMES 4096
+
+typedef struct {
+    uint32_t *posicoes;
+    size_t qtd, cap;
+} AchadosNome;
+
+typedef struct {
+    const IndiceTexto *t;
+    const char *regs;
+    size_t quantidade;
+    const char *chave;
+    const ListaTrigrama *menor; // NULL: todos os registros sao candidatos
+    size_t total;               // candidatos
+    AchadosNome *achados;       // um por pedaco
+} BuscaNome;
+
+void buscar_nome_pedaco(size_t k, void *ctx) {
+    BuscaNome *b = ctx;
+    AchadosNome *a = &b->achados[k];
+    char nome[TAM_NOME + 1];
+    size_t fim = (k + 1) * VARREDURA_NOMES < b->total ? (k + 1) * VARREDURA_NOMES : b->total;
+    for (size_t i = k * VARREDURA_NOMES; i < fim; ++i) {
+        size_t pos = b->menor ? b->menor->posicoes[i] : i;
+        if (pos >= b->quantidade) continue;
+        dobrar_texto(b->regs + pos * b->t->tam_registro + b->t->desloc_nome, TAM_NOME, nome, sizeof(nome));
+        if (strstr(nome, b->chave) == NULL) continue;
+        if (a->qtd == a->cap) {
+            size_t cap = a->cap ? a->cap * 2 : 16;
+            uint32_t *maior = realloc(a->posicoes, cap * sizeof(uint32_t));
+            if (!maior) return;
+            a->posicoes = maior;
+            a->cap = cap;
+        }
+        a->posicoes[a->qtd++] = (uint32_t)pos;
+    }
+}
+
+/* chama acao para cada registro cujo nome contem busca (sem diferenciar
+   maiusculas e acentos), na ordem do arquivo. buscas com menos de 3 letras
+   nao tem trigrama e percorrem o arquivo todo. retorna quantos achou */
+long texto_buscar(IndiceTexto *t, const char *busca, AcaoRegistro acao, void *ctx) {
+    double inicio = agora_segundos();
+    char chave[TAM_NOME + 1];
+    size_t n = dobrar_texto(busca, TAM_NOME, chave, sizeof(chave));
+    VisaoArquivo v;
+    if (!abrir_visao(&v, t->arquivo, t->tam_registro)) return 0;
+
+    // a lista mais curta guia; as outras so confirmam
+    const ListaTrigrama *menor = NULL;
+    int sem_candidatos = 0;
+    for (size_t i = 0; i + 3 <= n; ++i) {
+        const ListaTrigrama *l = texto_lista(t, trigrama_em(chave + i), 0);
+        if (!l) { sem_candidatos = 1; break; }
+        if (!menor || l->qtd < menor->qtd) menor = l;
+    }
+
+    BuscaNome b = { t, v.registros, v.quantidade, chave, menor, 0, NULL };
+    b.total = menor ? menor->qtd : (sem_candidatos ? 0 : v.quantidade);
+    size_t pedacos = (b.total + VARREDURA_NOMES - 1) / VARREDURA_NOMES;
+    long achados = 0;
+    if (pedacos > 0 && (b.achados = calloc(pedacos, sizeof(AchadosNome))) != NULL) {
+        varrer_em_paralelo(pedacos, buscar_nome_pedaco, &b);
+        for (size_t k = 0; k < pedacos; ++k) {
+            const AchadosNome *a = &b.achados[k];
+            for (size_t i = 0; i < a->qtd; ++i)
+                acao(b.regs + a->posicoes[i] * t->tam_registro, (long)a->posicoes[i], ctx);
+            achados += (long)a->qtd;
+            free(a->posicoes);
+        }
+        free(b.achados);
+    }
+    fechar_visao(&v);
+    medir(MED_BUSCA_NOME, inicio);
+    return achados;
+}
+
+//funcoes de Cliente
+
+// cliente lido da cauda do arquivo: entra tambem na busca por nome
+void indexar_cliente_novo(const void *reg, long pos, void *ctx) {
+    (void)ctx;
+    texto_indexar(&txt_clientes, ((const Cliente *)reg)->nome, pos);
+}
+
+// clientes cadastrados por outros terminais desde a ultima leitura
+void sincronizar_clientes() {
+    indice_ler_cauda(&idx_clientes, ARQ_CLIENTES, sizeof(Cliente), indexar_cliente_novo);
+}
+
+/* grava um cliente novo com codigo automatico. retorna 1 se gravou.
+   com o fim do arquivo travado, o que outro terminal cadastrou entra no
+   indice antes de gerar o codigo, entao dois terminais nunca gravam o mesmo */
+int registrar_cliente(Cliente *c) {
+    if (!travar_anexo(ARQ_CLIENTES)) return 0;
+    sincronizar_clientes();
+    c->codigo = gerar_codigo_cliente();
+    int ok = anexar_publicando(ALT_CLIENTE, &idx_clientes, ARQ_CLIENTES, c, 1, sizeof(Cliente));
+    destravar_anexo(ARQ_CLIENTES);
+    if (!ok) return 0;
+    texto_indexar(&txt_clientes, c->nome, idx_clientes.registros - 1);
+    return 1;
+}
+
+void cadastrar_cliente() {
+    Cliente c;
+    int gerado = c.codigo = gerar_codigo_cliente();
+    printf("Codigo gerado para cliente: %d\n", c.codigo);
+    printf("Nome: ");
+    limpar_buffer_scanf(); // Limpeza de buffer
+    fgets(c.nome, sizeof(c.nome), stdin); trim_newline(c.nome);
+    printf("Endereco: ");
+    fgets(c.endereco, sizeof(c.endereco), stdin); trim_newline(c.endereco);
+    printf("Telefone: ");
+    fgets(c.telefone, sizeof(c.telefone), stdin); trim_newline(c.telefone);
+
+    if (!registrar_cliente(&c)) {
+        perror("Erro ao abrir arquivo de clientes"); return;
+    }
+    if (c.codigo != gerado) printf("Codigo alterado para %d (o gerado foi usado por outro terminal).\n", c.codigo);
+    printf("Cliente cadastrado com sucesso!\n");
+}
+
+void mostrar_cliente(const Cliente *c) {
+    printf("Codigo: %d\nNome: %s\nEndereco: %s\nTelefone: %s\n",
+           c->codigo, c->nome, c->endereco, c->telefone);
+}
+
+void mostrar_cliente_achado(const void *reg, long pos, void *ctx) {
+    (void)pos; (void)ctx;
+    mostrar_cliente(reg); printf("----\n");
+}
+
+//busca por codigo ou nome (substring, sem diferenciar maiusculas e acentos)
+void pesquisar_cliente() {
+    printf("Pesquisar cliente por (1) codigo ou (2) nome? ");
+    int op; if (scanf("%d", &op) != 1) return;
+    FILE *f = abrir_dados(ARQ_CLIENTES, sizeof(Cliente), NULL);
+    if (!f) { printf("Nenhum cliente cadastrado.\n"); return; }
+    Cliente c;
+    int achou = 0;
+    if (op == 1) {
+        int cod; printf("Codigo: "); scanf("%d", &cod);
+        limpar_buffer_scanf(); // Limpa buffer aps o scanf
+        // busca pelo indice: um unico fseek em vez de ler o arquivo todo
+        long pos = indice_buscar(&idx_clientes, cod);
+        if (pos >= 0 && fseek(f, deslocamento_registro(pos, sizeof(Cliente)), SEEK_SET) == 0 &&
+            fread(&c, sizeof(Cliente), 1, f) == 1) {
+            mostrar_cliente(&c); achou = 1;
+        }
+    } else {
+        char busca[80];
+        printf("Nome (ou parte): ");
+        limpar_buffer_scanf(); // Limpeza de buffer
+        fgets(busca, sizeof(busca), stdin); trim_newline(busca);
+        achou = texto_buscar(&txt_clientes, busca, mostrar_cliente_achado, NULL) > 0;
+    }
+    if (!achou) printf("Cliente nao encontrado.\n");
+    fclose(f);
+}
+
+//funcoes de Funcionario
+
+void indexar_funcionario_novo(const void *reg, long pos, void *ctx) {
+    (void)ctx;
+    texto_indexar(&txt_funcionarios, ((const Funcionario *)reg)->nome, pos);
+}
+
+int registrar_funcionario(Funcionario *func) {
+    if (!travar_anexo(ARQ_FUNCIONARIOS)) return 0;
+    indice_ler_cauda(&idx_funcionarios, ARQ_FUNCIONARIOS, sizeof(Funcionario), indexar_funcionario_novo);
+    func->codigo = gerar_codigo_funcionario();
+    int ok = anexar_publicando(ALT_FUNCIONARIO, &idx_funcionarios, ARQ_FUNCIONARIOS, func, 1, sizeof(Funcionario));
+    destravar_anexo(ARQ_FUNCIONARIOS);
+    if (!ok) return 0;
+    texto_indexar(&txt_funcionarios, func->nome, idx_funcionarios.registros - 1);
+    return 1;
+}
+
+void cadastrar_funcionario() {
+    Funcionario func;
+    int gerado = func.codigo = gerar_codigo_funcionario();
+    printf("Codigo gerado para funcionario: %d\n", func.codigo);
+    printf("Nome: ");
+    limpar_buffer_scanf(); // Limpeza de buffer
+    fgets(func.nome, sizeof(func.nome), stdin); trim_newline(func.nome);
+    printf("Telefone: ");
+    fgets(func.telefone, sizeof(func.telefone), stdin); trim_newline(func.telefone);
+    printf("Cargo: ");
+    fgets(func.cargo, sizeof(func.cargo), stdin); trim_newline(func.cargo);
+    printf("Salario: ");
+    float salario = 0;
+    scanf("%f", &salario);
+    func.salario = salario;
+    limpar_buffer_scanf(); // Limpa buffer aps o scanf
+
+    if (!registrar_funcionario(&func)) {
+        perror("Erro ao abrir arquivo de funcionarios"); return;
+    }
+    if (func.codigo != gerado) printf("Codigo alterado para %d (o gerado foi usado por outro terminal).\n", func.codigo);
+    printf("Funcionario cadastrado com sucesso!\n");
+}
+
+void mostrar_funcionario(const Funcionario *p) {
+    printf("Codigo: %d\nNome: %s\nTelefone: %s\nCargo: %s\nSalario: %.2f\n",
+           p->codigo, p->nome, p->telefone, p->cargo, p->salario);
+}
+
+void mostrar_funcionario_achado(const void *reg, long pos, void *ctx) {
+    (void)pos; (void)ctx;
+    mostrar_funcionario(reg); printf("----\n");
+}
+
+void pesquisar_funcionario() {
+    printf("Pesquisar funcionario por (1) codigo ou (2) nome? ");
+    int op; if (scanf("%d", &op) != 1) return;
+    FILE *f = abrir_dados(ARQ_FUNCIONARIOS, sizeof(Funcionario), NULL);
+    if (!f) { printf("Nenhum funcionario cadastrado.\n"); return; }
+    Funcionario p;
+    int achou = 0;
+    if (op == 1) {
+        int cod; printf("Codigo: "); scanf("%d", &cod);
+        limpar_buffer_scanf(); // Limpa buffer aps o scanf
+        long pos = indice_buscar(&idx_funcionarios, cod);
+        if (pos >= 0 && fseek(f, deslocamento_registro(pos, sizeof(Funcionario)), SEEK_SET) == 0 &&
+            fread(&p, sizeof(Funcionario), 1, f) == 1) {
+            mostrar_funcionario(&p); achou = 1;
+        }
+    } else {
+        char busca[80];
+        printf("Nome (ou parte): ");
+        limpar_buffer_scanf(); // Limpeza de buffer
+        fgets(busca, sizeof(busca), stdin); trim_newline(busca);
+        achou = texto_buscar(&txt_funcionarios, busca, mostrar_funcionario_achado, NULL) > 0;
+    }
+    if (!achou) printf("Funcionario nao encontrado.\n");
+    fclose(f);
+}
+
+//funcoes de Quarto
+
+//verifica existencia de quarto por numero, se encontrado preenche q e retorna 1
+int quarto_existe(int numero, Quarto *q_out) {
+    double t = agora_segundos();
+    long pos = indice_buscar(&idx_quartos, numero);
+    if (pos < 0) return 0;
+    if (q_out && !ler_registro(ARQ_QUARTOS, sizeof(Quarto), pos, q_out)) return 0;
+    medir(MED_QUARTO_EXISTE, t);
+    return 1;
+}
+
+/* muda so o status do quarto, no lugar. com o registro travado ele e lido
+   de novo do arquivo, entao o que outro terminal gravou nos outros campos
+   nao se perde */
+int atualizar_quarto(int numero, int ocupado) {
+    long pos = indice_buscar(&idx_quartos, numero);
+    if (pos < 0 || !travar_registro(ARQ_QUARTOS, pos)) return 0;
+    Quarto q;
+    int ok = ler_registro(ARQ_QUARTOS, sizeof(Quarto), pos, &q);
+    if (ok && q.ocupado != (uint8_t)ocupado) {
+        q.ocupado = (uint8_t)ocupado;
+        ok = gravar_publicando(ALT_QUARTO, ARQ_QUARTOS, &q, sizeof(Quarto), pos);
+    }
+    destravar_registro(ARQ_QUARTOS, pos);
+    return ok;
+}
+
+//alocador de quartos: baldes por capacidade
+
+/* os quartos ficam agrupados em baldes por qtdHospedes, com os baldes em
+   ordem crescente de capacidade. dentro do balde os quartos ficam na ordem
+   do arquivo e ha uma segunda lista ordenada pela diaria. assim a busca
+   comeca direto no menor balde que comporta os hospedes e nunca passa
+   pelos quartos pequenos demais. */
+typedef enum {
+    ALOCACAO_PRIMEIRO = 1,  // primeiro quarto livre na ordem do arquivo (regra antiga)
+    ALOCACAO_MELHOR = 2,    // menor capacidade que comporta os hospedes
+    ALOCACAO_MAIS_BARATO = 3 // menor valorDiaria entre os que comportam
+} PoliticaAlocacao;
+
+PoliticaAlocacao politica_alocacao = ALOCACAO_MELHOR;
+
+typedef struct {
+    int numero;
+    float valorDiaria;
+    long posicao; // posicao no arquivo de quartos
+} QuartoAlocavel;
+
+typedef struct {
+    int capacidade;
+    QuartoAlocavel *itens;  // ordem do arquivo
+    QuartoAlocavel *baratos; // mesmos quartos ordenados por valorDiaria
+    size_t qtd, cap;
+} BaldeCapacidade;
+
+BaldeCapacidade *baldes = NULL;
+size_t qtd_baldes = 0, cap_baldes = 0;
+
+// primeiro balde com capacidade >= qtd (busca binaria)
+size_t balde_limite_inferior(int qtd) {
+    size_t ini = 0, fim = qtd_baldes;
+    while (ini < fim) {
+        size_t meio = ini + (fim - ini) / 2;
+        if (baldes[meio].capacidade < qtd) ini = meio + 1;
+        else fim = meio;
+    }
+    return ini;
+}
+
+int alocador_adicionar(const Quarto *q, long posicao) {
+    size_t k = balde_limite_inferior(q->qtdHospedes);
+    if (k == qtd_baldes || baldes[k].capacidade != q->qtdHospedes) {
+        if (qtd_baldes == cap_baldes) {
+            size_t nova_cap = cap_baldes ? cap_baldes * 2 : 8;
+            BaldeCapacidade *novos = realloc(baldes, nova_cap * sizeof(BaldeCapacidade));
+            if (!novos) return 0;
+            baldes = novos; cap_baldes = nova_cap;
+        }
+        memmove(&baldes[k + 1], &baldes[k], (qtd_baldes - k) * sizeof(BaldeCapacidade));
+        memset(&baldes[k], 0, sizeof(BaldeCapacidade));
+        baldes[k].capacidade = q->qtdHospedes;
+        qtd_baldes++;
+    }
+    BaldeCapacidade *b = &baldes[k];
+    if (b->qtd == b->cap) {
+        size_t nova_cap = b->cap ? b->cap * 2 : 4;
+        QuartoAlocavel *itens = realloc(b->itens, nova_cap * sizeof(QuartoAlocavel));
+        if (!itens) return 0;
+        b->itens = itens;
+        QuartoAlocavel *baratos = realloc(b->baratos, nova_cap * sizeof(QuartoAlocavel));
+        if (!baratos) return 0;
+        b->baratos = baratos;
+        b->cap = nova_cap;
+    }
+    QuartoAlocavel novo = { q->numero, q->valorDiaria, posicao };
+    // quartos novos sempre vao para o fim do arquivo
+    b->itens[b->qtd] = novo;
+    size_t j = b->qtd;
+    while (j > 0 && b->baratos[j - 1].valorDiaria > novo.valorDiaria) {
+        b->baratos[j] = b->baratos[j - 1];
+        j--;
+    }
+    b->baratos[j] = novo;
+    b->qtd++;
+    return 1;
+}
+
+// monta os baldes com uma leitura de quartos.dat (feito no inicio)
+void carregar_alocador() {
+    FILE *f = abrir_dados(ARQ_QUARTOS, sizeof(Quarto), NULL);
+    if (!f) return;
+    Quarto q;
+    long pos = 0;
+    while (fread(&q, sizeof(Quarto), 1, f) == 1) {
+        contar_lidos(1);
+        // numero repetido: vale o primeiro, igual ao indice
+        if (indice_buscar(&idx_quartos, q.numero) == pos) alocador_adicionar(&q, pos);
+        pos++;
+    }
+    fclose(f);
+}
+
+void liberar_alocador() {
+    for (size_t i = 0; i < qtd_baldes; ++i) {
+        free(baldes[i].itens);
+        free(baldes[i].baratos);
+    }
+    free(baldes);
+    baldes = NULL; qtd_baldes = cap_baldes = 0;
+}
+
+void configurar_alocacao() {
+    const char *nomes[] = { "", "primeiro livre (ordem do arquivo)", "melhor encaixe (menor capacidade)", "mais barato" };
+    printf("Politica atual: %s\n", nomes[politica_alocacao]);
+    printf("Nova politica: (1) primeiro livre, (2) melhor encaixe, (3) mais barato? ");
+    int op;
+    if (scanf("%d", &op) != 1 || op < 1 || op > 3) {
+        printf("Opcao invalida.\n");
+        limpar_buffer_scanf();
+        return;
+    }
+    limpar_buffer_scanf();
+    politica_alocacao = (PoliticaAlocacao)op;
+    printf("Politica de alocacao: %s\n", nomes[politica_alocacao]);
+}
+
+// quarto cadastrado por outro terminal (numero repetido: vale o primeiro)
+void adicionar_quarto_novo(const void *reg, long pos, void *ctx) {
+    (void)ctx;
+    const Quarto *q = reg;
+    if (indice_buscar(&idx_quartos, q->numero) == pos) alocador_adicionar(q, pos);
+}
+
+void sincronizar_quartos() {
+    indice_ler_cauda(&idx_quartos, ARQ_QUARTOS, sizeof(Quarto), adicionar_quarto_novo);
+}
+
+// grava um quarto novo. retorna NULL ou a mensagem de erro
+const char *registrar_quarto(Quarto *q) {
+    if (!travar_anexo(ARQ_QUARTOS)) return "Erro ao travar arquivo de quartos.";
+    sincronizar_quartos();
+    const char *erro = NULL;
+    q->ocupado = 0;
+    if (quarto_existe(q->numero, NULL)) erro = "Erro: quarto ja existe.";
+    else if (!anexar_publicando(ALT_QUARTO, &idx_quartos, ARQ_QUARTOS, q, 1, sizeof(Quarto))) erro = "Erro ao gravar arquivo de quartos.";
+    destravar_anexo(ARQ_QUARTOS);
+    if (!erro) alocador_adicionar(q, idx_quartos.registros - 1);
+    return erro;
+}
+
+void cadastrar_quarto() {
+    Quarto q;
+    int numero = 0, hospedes = 0;
+    float diaria = 0;
+    printf("Numero do quarto (inteiro): "); scanf("%d", &numero);
+    if (quarto_existe(numero, NULL)) {
+        printf("Erro: quarto ja existe.\n"); return;
+    }
+    printf("Quantidade de hospedes: "); scanf("%d", &hospedes);
+    printf("Valor da diaria (R$): "); scanf("%f", &diaria);
+    q.numero = numero;
+    q.qtdHospedes = (int16_t)hospedes;
+    q.valorDiaria = diaria;
+
+    limpar_buffer_scanf(); // Limpa o buffer aps o ltimo scanf
+
+    const char *erro = registrar_quarto(&q);
+    if (erro) { printf("%s\n", erro); return; }
+    printf("Quarto cadastrado com sucesso!\n");
+}
+
+//funcoes de Estadia
+
+//agenda por quarto: estadias ativas ordenadas por data de entrada
+
+/* cada quarto tem um vetor ordenado pela entrada so com as estadias ativas.
+   como o cadastro nunca deixa duas estadias ativas do mesmo quarto se
+   sobreporem, os intervalos de um quarto sao disjuntos e ficam ordenados
+   tambem pela saida. ao lado fica um mapa de bits com um bit por dia
+   (1 = ocupado), em palavras de 64 dias alinhadas; conferir um periodo e
+   um AND por palavra coberta, e o calendario do mes sai direto do mapa. */
+typedef struct {
+    Data entrada;
+    Data saida;
+    int codigo;
+} Intervalo;
+
+typedef struct {
+    int numeroQuarto;
+    Intervalo *itens;
+    size_t qtd, cap;
+    Data dia_base;    // primeiro dia do mapa (multiplo de 64)
+    uint64_t *dias;   // bit d - dia_base = dia d ocupado
+    size_t palavras;
+} AgendaQuarto;
+
+AgendaQuarto *agendas = NULL;
+size_t qtd_agendas = 0, cap_agendas = 0;
+Indice idx_agendas; // numero do quarto -> posicao em agendas[]
+
+AgendaQuarto *agenda_do_quarto(int numeroQuarto, int criar) {
+    long pos = indice_buscar(&idx_agendas, numeroQuarto);
+    if (pos >= 0) return &agendas[pos];
+    if (!criar) return NULL;
+    if (qtd_agendas == cap_agendas) {
+        size_t nova_cap = cap_agendas ? cap_agendas * 2 : 16;
+        AgendaQuarto *novas = realloc(agendas, nova_cap * sizeof(AgendaQuarto));
+        if (!novas) return NULL;
+        agendas = novas; cap_agendas = nova_cap;
+    }
+    AgendaQuarto *a = &agendas[qtd_agendas];
+    memset(a, 0, sizeof(*a));
+    a->numeroQuarto = numeroQuarto;
+    indice_inserir(&idx_agendas, numeroQuarto, (long)qtd_agendas);
+    qtd_agendas++;
+    return a;
+}
+
+// numero da palavra de 64 dias que contem o dia (arredonda para baixo)
+Data palavra_do_dia(Data dia) {
+    return dia >= 0 ? dia / 64 : -((63 - dia) / 64);
+}
+
+// bits lo..hi-1 ligados
+uint64_t mascara_dias(int lo, int hi) {
+    uint64_t ate_hi = hi >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << hi) - 1;
+    return ate_hi & ~(((uint64_t)1 << lo) - 1);
+}
+
+// aumenta o mapa para cobrir os dias [inicio, fim)
+int agenda_cobrir(AgendaQuarto *a, Data inicio, Data fim) {
+    Data base = palavra_do_dia(inicio) * 64, limite = (palavra_do_dia(fim - 1) + 1) * 64;
+    Data atual_fim = a->dia_base + (Data)a->palavras * 64;
+    if (a->palavras > 0) {
+        if (base >= a->dia_base && limite <= atual_fim) return 1;
+        if (a->dia_base < base) base = a->dia_base;
+        if (atual_fim > limite) limite = atual_fim;
+    }
+    size_t n = (size_t)(limite - base) / 64;
+    uint64_t *novos = calloc(n, sizeof(uint64_t));
+    if (!novos) return 0;
+    if (a->palavras > 0)
+        memcpy(novos + (a->dia_base - base) / 64, a->dias, a->palavras * sizeof(uint64_t));
+    free(a->dias);
+    a->dias = novos;
+    a->dia_base = base;
+    a->palavras = n;
+    return 1;
+}
+
+// liga ou desliga os dias [inicio, fim); o mapa ja tem que cobrir o periodo
+void agenda_marcar(AgendaQuarto *a, Data inicio, Data fim, int ocupado) {
+    for (Data d = inicio; d < fim; ) {
+        size_t w = (size_t)(d - a->dia_base) / 64;
+        Data palavra_ini = a->dia_base + (Data)w * 64;
+        int hi = fim - palavra_ini >= 64 ? 64 : (int)(fim - palavra_ini);
+        uint64_t m = mascara_dias((int)(d - palavra_ini), hi);
+        if (ocupado) a->dias[w] |= m;
+        else a->dias[w] &= ~m;
+        d = palavra_ini + 64;
+    }
+}
+
+// 1 se nenhum dia de [inicio, fim) esta ocupado no mapa
+int agenda_dias_livres(const AgendaQuarto *a, Data inicio, Data fim) {
+    Data mapa_fim = a->dia_base + (Data)a->palavras * 64;
+    if (inicio < a->dia_base) inicio = a->dia_base;
+    if (fim > mapa_fim) fim = mapa_fim;
+    for (Data d = inicio; d < fim; ) {
+        size_t w = (size_t)(d - a->dia_base) / 64;
+        Data palavra_ini = a->dia_base + (Data)w * 64;
+        int hi = fim - palavra_ini >= 64 ? 64 : (int)(fim - palavra_ini);
+        if (a->dias[w] & mascara_dias((int)(d - palavra_ini), hi)) return 0;
+        d = palavra_ini + 64;
+    }
+    return 1;
+}
+
+int agenda_dia_ocupado(const AgendaQuarto *a, Data dia) {
+    if (!a || dia < a->dia_base || dia >= a->dia_base + (Data)a->palavras * 64) return 0;
+    size_t i = (size_t)(dia - a->dia_base);
+    return (int)((a->dias[i / 64] >> (i % 64)) & 1);
+}
+
+// primeira posicao cuja entrada e >= data (busca binaria)
+size_t agenda_limite_inferior(const AgendaQuarto *a, Data data) {
+    size_t ini = 0, fim = a->qtd;
+    while (ini < fim) {
+        size_t meio = ini + (fim - ini) / 2;
+        if (a->itens[meio].entrada < data) ini = meio + 1;
+        else fim = meio;
+    }
+    return ini;
+}
+
+int agenda_inserir(const Estadia *e) {
+    AgendaQuarto *a = agenda_do_quarto(e->numeroQuarto, 1);
+    if (!a || !agenda_cobrir(a, e->dataEntrada, e->dataSaida)) return 0;
+    if (a->qtd == a->cap) {
+        size_t nova_cap = a->cap ? a->cap * 2 : 4;
+        Intervalo *novos = realloc(a->itens, nova_cap * sizeof(Intervalo));
+        if (!novos) return 0;
+        a->itens = novos; a->cap = nova_cap;
+    }
+    size_t k = agenda_limite_inferior(a, e->dataEntrada);
+    memmove(&a->itens[k + 1], &a->itens[k], (a->qtd - k) * sizeof(Intervalo));
+    a->itens[k].entrada = e->dataEntrada;
+    a->itens[k].saida = e->dataSaida;
+    a->itens[k].codigo = e->codigo;
+    a->qtd++;
+    agenda_marcar(a, e->dataEntrada, e->dataSaida, 1);
+    return 1;
+}
+
+void agenda_remover(const Estadia *e) {
+    AgendaQuarto *a = agenda_do_quarto(e->numeroQuarto, 0);
+    if (!a) return;
+    size_t k = agenda_limite_inferior(a, e->dataEntrada);
+    for (; k < a->qtd && a->itens[k].entrada == e->dataEntrada; ++k) {
+        if (a->itens[k].codigo == e->codigo) {
+            memmove(&a->itens[k], &a->itens[k + 1], (a->qtd - k - 1) * sizeof(Intervalo));
+            a->qtd--;
+            agenda_marcar(a, e->dataEntrada, e->dataSaida, 0);
+            // dados antigos podem ter estadias sobrepostas: remarca as vizinhas
+            for (size_t j = agenda_limite_inferior(a, e->dataSaida); j > 0 && a->itens[j - 1].saida > e->dataEntrada; --j)
+                agenda_marcar(a, a->itens[j - 1].entrada, a->itens[j - 1].saida, 1);
+            return;
+        }
+    }
+}
+
+/* poe o codigo na estadia ativa que entrou na agenda ainda sem ele
+   (importacao). os intervalos do quarto sao disjuntos: a entrada acha o item */
+void agenda_definir_codigo(const Estadia *e) {
+    AgendaQuarto *a = agenda_do_quarto(e->numeroQuarto, 0);
+    if (!a) return;
+    size_t k = agenda_limite_inferior(a, e->dataEntrada);
+    if (k < a->qtd && a->itens[k].entrada == e->dataEntrada) a->itens[k].codigo = e->codigo;
+}
+
+/* quantas baixas ja estao refletidas nas agendas. cada baixa gravada soma 1
+   em CabecalhoArquivo.alteracoes de estadias.dat; se o numero no arquivo
+   passou do visto, outro terminal liberou um periodo e as agendas sao
+   remontadas (estadias novas de outros terminais chegam pela cauda) */
+uint32_t alteracoes_vistas = 0;
+uint32_t geracao_vista = 0; // compactacoes ja refletidas em idx_estadias
+
+// monta as agendas com uma unica leitura de estadias.dat (feito no inicio)
+void carregar_agendas() {
+    CabecalhoArquivo cab;
+    FILE *f = abrir_dados(ARQ_ESTADIAS, sizeof(Estadia), &cab);
+    if (!f) return;
+    alteracoes_vistas = cab.alteracoes;
+    geracao_vista = cab.geracao;
+    Estadia e;
+    while (fread(&e, sizeof(Estadia), 1, f) == 1) {
+        contar_lidos(1);
+        if (e.ativo == 1) agenda_inserir(&e);
+    }
+    fclose(f);
+}
+
+void liberar_agendas() {
+    for (size_t i = 0; i < qtd_agendas; ++i) {
+        free(agendas[i].itens);
+        free(agendas[i].dias);
+    }
+    free(agendas);
+    agendas = NULL; qtd_agendas = cap_agendas = 0;
+    indice_liberar(&idx_agendas);
+}
+
+// verifica se existe alguma estadia ativa no mesmo quarto que conflita com periodo novo
+int periodo_livre(int numeroQuarto, Data entrada, Data saida) {
+    AgendaQuarto *a = agenda_do_quarto(numeroQuarto, 0);
+    if (!a || a->qtd == 0) return 1; // sem estadias ativas -> livre
+    return agenda_dias_livres(a, entrada, saida);
+}
+
+/* escolhe um quarto com capacidade >= qtd e sem conflito de datas segundo a
+   politica_alocacao. o campo 'ocupado' nao entra na escolha, so o conflito
+   de datas (igual a regra antiga do cadastro). retorna 1 e preenche q_out */
+int alocar_quarto(int qtd, Data entrada, Data saida, Quarto *q_out) {
+    const QuartoAlocavel *escolhido = NULL;
+    for (size_t k = balde_limite_inferior(qtd); k < qtd_baldes; ++k) {
+        const BaldeCapacidade *b = &baldes[k];
+        const QuartoAlocavel *lista = politica_alocacao == ALOCACAO_MAIS_BARATO ? b->baratos : b->itens;
+        for (size_t i = 0; i < b->qtd; ++i) {
+            const QuartoAlocavel *c = &lista[i];
+            // os proximos deste balde so podem ser piores que o ja escolhido
+            if (escolhido && politica_alocacao == ALOCACAO_PRIMEIRO && c->posicao > escolhido->posicao) break;
+            if (escolhido && politica_alocacao == ALOCACAO_MAIS_BARATO && c->valorDiaria >= escolhido->valorDiaria) break;
+            if (periodo_livre(c->numero, entrada, saida)) {
+                escolhido = c;
+                break;
+            }
+        }
+        // melhor encaixe: o primeiro balde com quarto livre ja e a resposta
+        if (escolhido && politica_alocacao == ALOCACAO_MELHOR) break;
+    }
+    if (!escolhido) return 0;
+    return ler_registro(ARQ_QUARTOS, sizeof(Quarto), escolhido->posicao, q_out);
+}
+
+// sobrescreve no lugar a estadia com mesmo codigo (finalizar/atualizar).
+// chamar com o registro travado
+int atualizar_estadia(Estadia e_atualizada) {
+    long pos = indice_buscar(&idx_estadias, e_atualizada.codigo);
+    if (pos < 0) return 0;
+    return gravar_publicando(ALT_ESTADIA, ARQ_ESTADIAS, &e_atualizada, sizeof(Estadia), pos);
+}
+
+//estadias finalizadas arquivadas por mes
+
+/* a compactacao (opcao 19, --compactar) tira de estadias.dat as estadias
+   finalizadas e as acrescenta em um arquivo por mes de entrada
+   (estadias-AAAAMM.arq), que so cresce. estadias.arq lista os meses que
+   tem arquivo. cada compactacao grava um bloco por mes: CabecalhoBloco e as
+   estadias ordenadas por codigo, cada campo como diferenca para o anterior
+   (ou para o dia 1 do mes) em inteiros de tamanho variavel (7 bits por
+   byte), uns 9 bytes por estadia em vez de 23. o bloco leva a geracao da
+   compactacao e so vale se estadias.dat ja tem essa geracao: se o programa
+   cair antes de trocar estadias.dat, o bloco fica sobrando, ninguem o le
+   e a proxima compactacao do mes o corta. */
+#define MAX_VARINTS_ESTADIA 30 // 6 campos x 5 bytes no pior caso
+
+typedef void (*AcaoEstadia)(const Estadia *e, void *ctx);
+
+// AAAAMM do mes da data
+int32_t mes_da_data(Data d) {
+    int a, m, dia;
+    civil_de_data(d, &a, &m, &dia);
+    return a * 100 + m;
+}
+
+void nome_do_mes(int32_t mes, char *nome, size_t tam) {
+    snprintf(nome, tam, ARQ_MES_ARQUIVADO, (int)mes);
+}
+
+uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (v < 0 ? 0xFFFFFFFFu : 0);
+}
+
+int32_t dezigzag(uint32_t u) {
+    return (int32_t)((u >> 1) ^ (0u - (u & 1)));
+}
+
+uint8_t *gravar_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// NULL se o numero passa do fim (bloco cortado)
+const uint8_t *ler_varint(const uint8_t *p, const uint8_t *fim, uint32_t *v) {
+    *v = 0;
+    for (int desloc = 0; p < fim && desloc < 35; desloc += 7) {
+        uint8_t b = *p++;
+        *v |= (uint32_t)(b & 0x7F) << desloc;
+        if (!(b & 0x80)) return p;
+    }
+    return NULL;
+}
+
+// estadias do mes ordenadas por codigo -> bytes em saida. retorna o tamanho
+size_t bloco_codificar(const Estadia *es, size_t n, int32_t mes, uint8_t *saida) {
+    Data inicio = data_de_civil(mes / 100, mes % 100, 1);
+    int32_t anterior = 0;
+    uint8_t *p = saida;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t noites = es[i].dataSaida - es[i].dataEntrada;
+        p = gravar_varint(p, zigzag(es[i].codigo - anterior));
+        p = gravar_varint(p, zigzag(es[i].dataEntrada - inicio));
+        p = gravar_varint(p, zigzag(noites));
+        p = gravar_varint(p, zigzag(es[i].qtdDiarias - noites));
+        p = gravar_varint(p, zigzag(es[i].codCliente));
+        p = gravar_varint(p, zigzag(es[i].numeroQuarto));
+        anterior = es[i].codigo;
+    }
+    return (size_t)(p - saida);
+}
+
+// chama acao para cada estadia do bloco. retorna 0 se o bloco nao bate
+int bloco_decodificar(const uint8_t *p, size_t tam, uint32_t qtd, int32_t mes, AcaoEstadia acao, void *ctx) {
+    const uint8_t *fim = p + tam;
+    Data inicio = data_de_civil(mes / 100, mes % 100, 1);
+    int32_t anterior = 0;
+    for (uint32_t i = 0; i < qtd; ++i) {
+        uint32_t v[6];
+        for (int c = 0; c < 6; ++c)
+            if (!(p = ler_varint(p, fim, &v[c]))) return 0;
+        Estadia e;
+        memset(&e, 0, sizeof(e));
+        e.codigo = anterior + dezigzag(v[0]);
+        e.dataEntrada = inicio + dezigzag(v[1]);
+        e.dataSaida = e.dataEntrada + dezigzag(v[2]);
+        e.qtdDiarias = (int16_t)(dezigzag(v[2]) + dezigzag(v[3]));
+        e.codCliente = dezigzag(v[4]);
+        e.numeroQuarto = dezigzag(v[5]);
+        anterior = e.codigo;
+        if (acao) acao(&e, ctx);
+    }
+    contar_lidos(qtd); // roda nos fios de varrer_em_paralelo
+    return p == fim;
+}
+
+/* le o arquivo do mes e passa as estadias dos blocos com geracao <= maxima.
+   para no primeiro bloco cortado ou com soma errada (gravacao que caiu no
+   meio). em valido fica o tamanho ate o ultimo bloco que vale (a
+   compactacao corta o resto). retorna quantas estadias passaram */
+long particao_ler(int32_t mes, uint32_t geracao_maxima, AcaoEstadia acao, void *ctx, long *valido) {
+    char nome[64];
+    nome_do_mes(mes, nome, sizeof(nome));
+    if (valido) *valido = 0;
+    FILE *f = fopen(nome, "rb");
+    if (!f) return 0;
+    long tam = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    uint8_t *dados = tam > 0 ? malloc((size_t)tam) : NULL;
+    size_t lidos = 0;
+    if (dados) {
+        rewind(f);
+        lidos = fread(dados, 1, (size_t)tam, f); // menos se outro processo cortou o fim
+    }
+    fclose(f);
+    long n = 0;
+    size_t pos = 0;
+    while (pos + sizeof(CabecalhoBloco) <= lidos) {
+        CabecalhoBloco b;
+        memcpy(&b, dados + pos, sizeof(b));
+        const uint8_t *corpo = dados + pos + sizeof(b);
+        if (memcmp(b.magia, "HDGB", 4) != 0 || b.tam > lidos - pos - sizeof(b) ||
+            soma_verificacao(corpo, b.tam, 2166136261u) != b.soma || b.geracao > geracao_maxima) break;
+        if (!bloco_decodificar(corpo, b.tam, b.qtd, mes, acao, ctx)) break;
+        n += b.qtd;
+        pos += sizeof(b) + b.tam;
+        if (valido) *valido = (long)pos;
+    }
+    free(dados);
+    return n;
+}
+
+int comparar_mes(const void *a, const void *b) {
+    const ParticaoEstadias *x = a, *y = b;
+    return (x->mes > y->mes) - (x->mes < y->mes);
+}
+
+/* meses com arquivo, em ordem, copiados de estadias.arq. NULL e *qtd = 0
+   se nada foi arquivado ainda */
+ParticaoEstadias *particoes_listar(size_t *qtd) {
+    *qtd = 0;
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_PARTICOES, sizeof(ParticaoEstadias))) return NULL;
+    ParticaoEstadias *ps = v.quantidade ? malloc(v.quantidade * sizeof(ParticaoEstadias)) : NULL;
+    if (ps) {
+        memcpy(ps, v.registros, v.quantidade * sizeof(ParticaoEstadias));
+        *qtd = v.quantidade;
+        qsort(ps, *qtd, sizeof(ParticaoEstadias), comparar_mes);
+    }
+    fechar_visao(&v);
+    return ps;
+}
+
+/* todas as estadias em pedacos para varrer_em_paralelo: um por mes
+   arquivado e faixas de VARREDURA_ESTADIAS registros de estadias.dat. a
+   visao de estadias.dat e aberta antes dos arquivos mensais e so os blocos
+   da geracao dela contam: se uma compactacao acabar no meio da leitura, a
+   visao antiga ainda tem o que os blocos novos teriam. */
+#define VARREDURA_ESTADIAS 16384
+
+typedef int (*FiltroEstadia)(const Estadia *e, const void *ctx);
+
+typedef struct {
+    int32_t mes;          // mes arquivado, ou 0: faixa [inicio, fim) de estadias.dat
+    size_t inicio, fim;
+} PedacoEstadias;
+
+typedef struct {
+    VisaoArquivo v;
+    int tem_quentes;
+    uint32_t geracao;
+    PedacoEstadias *pedacos;
+    size_t qtd;
+} VarreduraEstadias;
+
+// retorna 0 se faltou memoria
+int varredura_abrir(VarreduraEstadias *vr) {
+    memset(vr, 0, sizeof(*vr));
+    vr->tem_quentes = abrir_visao(&vr->v, ARQ_ESTADIAS, sizeof(Estadia));
+    if (vr->tem_quentes) vr->geracao = ((const CabecalhoArquivo *)vr->v.base)->geracao;
+    size_t meses;
+    ParticaoEstadias *ps = particoes_listar(&meses);
+    size_t faixas = vr->tem_quentes ? (vr->v.quantidade + VARREDURA_ESTADIAS - 1) / VARREDURA_ESTADIAS : 0;
+    if (meses + faixas > 0 && !(vr->pedacos = malloc((meses + faixas) * sizeof(PedacoEstadias)))) {
+        free(ps);
+        if (vr->tem_quentes) fechar_visao(&vr->v);
+        return 0;
+    }
+    for (size_t i = 0; i < meses; ++i) {
+        PedacoEstadias p = { ps[i].mes, 0, 0 };
+        vr->pedacos[vr->qtd++] = p;
+    }
+    for (size_t i = 0; i < faixas; ++i) {
+        size_t fim = (i + 1) * VARREDURA_ESTADIAS;
+        PedacoEstadias p = { 0, i * VARREDURA_ESTADIAS, fim < vr->v.quantidade ? fim : vr->v.quantidade };
+        vr->pedacos[vr->qtd++] = p;
+    }
+    free(ps);
+    return 1;
+}
+
+void varredura_fechar(VarreduraEstadias *vr) {
+    free(vr->pedacos);
+    if (vr->tem_quentes) fechar_visao(&vr->v);
+}
+
+// chama acao para cada estadia do pedaco k, em ordem. retorna quantas
+long varredura_pedaco(const VarreduraEstadias *vr, size_t k, AcaoEstadia acao, void *ctx) {
+    const PedacoEstadias *p = &vr->pedacos[k];
+    if (p->mes != 0) return particao_ler(p->mes, vr->geracao, acao, ctx, NULL);
+    const Estadia *es = vr->v.registros;
+    for (size_t i = p->inicio; i < p->fim; ++i) acao(&es[i], ctx);
+    return (long)(p->fim - p->inicio);
+}
+
+// estadias de um pedaco que passaram no filtro
+typedef struct {
+    FiltroEstadia filtro;
+    const void *ctx_filtro;
+    Estadia *es;
+    size_t qtd, cap;
+    int falhou;
+} ColetaEstadias;
+
+typedef struct {
+    const VarreduraEstadias *vr;
+    ColetaEstadias *coletas;
+} FiltragemEstadias;
+
+void coletar_estadia(const Estadia *e, void *ctx) {
+    ColetaEstadias *c = ctx;
+    if (c->filtro && !c->filtro(e, c->ctx_filtro)) return;
+    if (c->qtd == c->cap) {
+        size_t cap = c->cap ? c->cap * 2 : 64;
+        Estadia *maior = realloc(c->es, cap * sizeof(Estadia));
+        if (!maior) { c->falhou = 1; return; }
+        c->es = maior;
+        c->cap = cap;
+    }
+    c->es[c->qtd++] = *e;
+}
+
+void filtrar_pedaco(size_t k, void *ctx) {
+    FiltragemEstadias *f = ctx;
+    varredura_pedaco(f->vr, k, coletar_estadia, &f->coletas[k]);
+}
+
+/* chama acao, no fio de quem chamou, para cada estadia (arquivada ou em
+   estadias.dat) que passa no filtro. os pedacos sao lidos e filtrados em
+   paralelo e o resultado sai na mesma ordem de percorrer_estadias. retorna
+   quantas passaram, ou -1 se faltou memoria */
+long filtrar_estadias(FiltroEstadia filtro, const void *ctx_filtro, AcaoEstadia acao, void *ctx) {
+    VarreduraEstadias vr;
+    if (!varredura_abrir(&vr)) return -1;
+    FiltragemEstadias f = { &vr, calloc(vr.qtd ? vr.qtd : 1, sizeof(ColetaEstadias)) };
+    if (!f.coletas) { varredura_fechar(&vr); return -1; }
+    for (size_t k = 0; k < vr.qtd; ++k) {
+        f.coletas[k].filtro = filtro;
+        f.coletas[k].ctx_filtro = ctx_filtro;
+    }
+    varrer_em_paralelo(vr.qtd, filtrar_pedaco, &f);
+
+    long n = 0;
+    int falhou = 0;
+    for (size_t k = 0; k < vr.qtd; ++k)
+        if (f.coletas[k].falhou) falhou = 1;
+    for (size_t k = 0; !falhou && k < vr.qtd; ++k) {
+        ColetaEstadias *c = &f.coletas[k];
+        for (size_t i = 0; i < c->qtd; ++i) acao(&c->es[i], ctx);
+        n += (long)c->qtd;
+    }
+    for (size_t k = 0; k < vr.qtd; ++k) free(f.coletas[k].es);
+    free(f.coletas);
+    varredura_fechar(&vr);
+    return falhou ? -1 : n;
+}
+
+/* chama acao para cada estadia, primeiro as arquivadas (mes a mes) e depois
+   as de estadias.dat. sem filtro nao ha o que dividir entre fios: le os
+   pedacos em ordem direto para acao. retorna quantas estadias passaram */
+long percorrer_estadias(AcaoEstadia acao, void *ctx) {
+    VarreduraEstadias vr;
+    if (!varredura_abrir(&vr)) {
+        printf("Memoria insuficiente para ler as estadias.\n");
+        return 0;
+    }
+    long n = 0;
+    for (size_t k = 0; k < vr.qtd; ++k) n += varredura_pedaco(&vr, k, acao, ctx);
+    varredura_fechar(&vr);
+    return n;
+}
+
+typedef struct {
+    int codigo;
+    Estadia *achada;
+    int achou;
+} BuscaArquivada;
+
+void procurar_arquivada(const Estadia *e, void *ctx) {
+    BuscaArquivada *b = ctx;
+    if (!b->achou && e->codigo == b->codigo && e->ativo == 0) { *b->achada = *e; b->achou = 1; }
+}
+
+// procura nos arquivos mensais uma estadia que ja saiu de estadias.dat
+int estadia_arquivada(int cod, Estadia *e) {
+    BuscaArquivada b = { cod, e, 0 };
+    CabecalhoArquivo cab;
+    FILE *f = abrir_dados(ARQ_ESTADIAS, sizeof(Estadia), &cab);
+    if (!f) return 0;
+    fclose(f);
+    size_t qtd;
+    ParticaoEstadias *ps = particoes_listar(&qtd);
+    for (size_t i = 0; i < qtd && !b.achou; ++i) particao_ler(ps[i].mes, cab.geracao, procurar_arquivada, &b, NULL);
+    free(ps);
+    return b.achou;
+}
+
+// 1 se ha estadia em estadias.dat ou arquivada
+int ha_estadias() {
+    if (idx_estadias.registros > 0) return 1;
+    FILE *f = fopen(ARQ_PARTICOES, "rb");
+    if (!f) return 0;
+    fclose(f);
+    return 1;
+}
+
+//tarifas: preco por noite compilado das regras
+
+/* dinheiro em centavos inteiros. a diaria base de cada quarto continua
+   gravada em quartos.dat como sempre e vira centavos (arredondada) uma vez,
+   quando as tabelas sao montadas; dali em diante nenhuma conta usa float */
+typedef int64_t Centavos;
+
+#define TAM_REAIS 24
+
+Centavos centavos_de_reais(double reais) {
+    return (Centavos)(reais * 100 + (reais < 0 ? -0.5 : 0.5));
+}
+
+// escreve "1234.56" em destino e devolve destino
+const char *formatar_centavos(Centavos valor, char destino[TAM_REAIS]) {
+    Centavos abs = valor < 0 ? -valor : valor;
+    snprintf(destino, TAM_REAIS, "%s%lld.%02lld", valor < 0 ? "-" : "", (long long)(abs / 100), (long long)(abs % 100));
+    return destino;
+}
+
+/* regras em tarifas.txt, lidas ao abrir o programa e na opcao 20 do menu
+   (campos separados por ';', linhas vazias e '#' sao ignoradas). cada uma
+   e um ajuste em % sobre a diaria base:
+     temporada;DD/MM/AAAA;DD/MM/AAAA;ajuste[;quarto]  noites do primeiro ao ultimo dia
+     temporada;DD/MM;DD/MM;ajuste[;quarto]            a mesma faixa todo ano (pode virar o ano)
+     dia;dom|seg|ter|qua|qui|sex|sab;ajuste[;quarto]
+     ocupacao;limite;ajuste                           noites com >= limite% dos quartos vendidos
+   quarto ausente ou 0 = todos. os ajustes de temporada e dia somam; das
+   regras de ocupacao vale so a de maior limite atingido. preco da noite =
+   base * (100% + ajustes), arredondado ao centavo e nunca negativo.
+
+   as regras sao compiladas por ano: um vetor por quarto com a soma dos
+   precos das noites antes de cada dia, entao o preco de qualquer periodo
+   dentro do ano e uma subtracao. a ocupacao de cada noite conta todas as
+   estadias (ativas, finalizadas e arquivadas): a tabela soma as novas de
+   estadias.dat pela cauda e so refaz os precos a partir da primeira noite
+   que mudou de faixa de ocupacao */
+#define ARQ_TARIFAS "tarifas.txt"
+#define TARIFA_ANOS 4        // tabelas de ano guardadas; a mais antiga sai
+#define TARIFA_MAX_CAMPOS 6
+#define TARIFA_MAX_OCUPACAO 255
+
+typedef enum { REGRA_TEMPORADA, REGRA_DIA, REGRA_OCUPACAO } TipoRegra;
+
+typedef struct {
+    TipoRegra tipo;
+    int32_t de, ate;  // temporada: dias [de, ate], ou MMDD se anual
+    int anual;
+    int semana;       // dia: 0 = domingo
+    int limite;       // ocupacao: % minimo de quartos vendidos na noite
+    int32_t quarto;   // 0 = todos
+    int32_t ajuste;   // centesimos de ponto percentual (1000 = +10%)
+} RegraTarifa;
+
+typedef struct {
+    int ano;
+    Data inicio;        // 01/01 do ano
+    int dias;
+    int32_t *ajuste;    // temporada e dia da semana das regras de todos os quartos, por noite
+    int32_t *vendidas;  // quartos vendidos por noite (so com regras de ocupacao)
+    uint8_t *faixa;     // 1 + regra de ocupacao que vale na noite (0 = nenhuma)
+    uint32_t geracao;   // de estadias.dat quando as vendas foram contadas
+    size_t contadas;    // registros de estadias.dat ja somados em vendidas
+    int valido_ate;     // os prefixos valem ate este dia; depois sao refeitos
+    Centavos *prefixo;  // por linha, dias + 1 somas: noites de inicio ate inicio + d
+} TabelaAno;
+
+/* uma linha por registro de quartos.dat (a posicao do indice, entao vale o
+   primeiro de cada numero) e mais uma zerada para quarto que nao existe */
+typedef struct {
+    RegraTarifa *regras;    // temporada e dia
+    size_t qtd_regras;
+    RegraTarifa *ocupacao;  // por limite crescente
+    size_t qtd_ocupacao;
+    int32_t *numeros;
+    Centavos *base;
+    size_t qtd_linhas;
+    size_t qtd_quartos;     // numeros distintos, para a % de ocupacao
+    TabelaAno *anos[TARIFA_ANOS];
+    size_t qtd_anos;
+} Tarifario;
+
+Tarifario tarifario;
+
+const char *dias_semana[] = { "dom", "seg", "ter", "qua", "qui", "sex", "sab" };
+
+void tabela_liberar(TabelaAno *t) {
+    free(t->ajuste); free(t->vendidas); free(t->faixa); free(t->prefixo);
+    free(t);
+}
+
+void tarifas_esquecer_tabelas() {
+    for (size_t i = 0; i < tarifario.qtd_anos; ++i) tabela_liberar(tarifario.anos[i]);
+    tarifario.qtd_anos = 0;
+}
+
+void liberar_tarifas() {
+    tarifas_esquecer_tabelas();
+    free(tarifario.regras); free(tarifario.ocupacao);
+    free(tarifario.numeros); free(tarifario.base);
+    memset(&tarifario, 0, sizeof(tarifario));
+}
+
+// "DD/MM/AAAA" (numero do dia) ou "DD/MM" (MMDD, todo ano)
+int campo_dia_tarifa(const char *campo, int32_t *valor, int *anual) {
+    int d, m;
+    char resto;
+    *anual = sscanf(campo, "%d/%d%c", &d, &m, &resto) == 2;
+    if (!*anual) return campo_data(campo, valor);
+    // 29/02 fica valido: so conta nos anos bissextos
+    if (m < 1 || m > 12 || d < 1 || d > 31) return 0;
+    *valor = m * 100 + d;
+    return 1;
+}
+
+// uma linha de tarifas.txt ja separada em campos. retorna NULL ou o erro
+const char *regra_de_campos(char **c, size_t n, RegraTarifa *r) {
+    memset(r, 0, sizeof(*r));
+    float ajuste = 0;
+    int quarto = 0;
+    if (strcmp(c[0], "temporada") == 0) {
+        int anual_ate;
+        if ((n != 4 && n != 5) || !campo_dia_tarifa(c[1], &r->de, &r->anual) ||
+            !campo_dia_tarifa(c[2], &r->ate, &anual_ate) || r->anual != anual_ate ||
+            !campo_real(c[3], &ajuste) || (n == 5 && !campo_inteiro(c[4], &quarto)))
+            return "uso: temporada;DD/MM[/AAAA];DD/MM[/AAAA];ajuste[;quarto]";
+        if (!r->anual && r->ate < r->de) return "temporada termina antes de comecar";
+        r->tipo = REGRA_TEMPORADA;
+    } else if (strcmp(c[0], "dia") == 0) {
+        r->semana = -1;
+        for (int i = 0; n >= 2 && i < 7; ++i)
+            if (strcmp(c[1], dias_semana[i]) == 0) r->semana = i;
+        if ((n != 3 && n != 4) || r->semana < 0 || !campo_real(c[2], &ajuste) ||
+            (n == 4 && !campo_inteiro(c[3], &quarto)))
+            return "uso: dia;dom|seg|ter|qua|qui|sex|sab;ajuste[;quarto]";
+        r->tipo = REGRA_DIA;
+    } else if (strcmp(c[0], "ocupacao") == 0) {
+        if (n != 3 || !campo_inteiro(c[1], &r->limite) || r->limite < 1 || r->limite > 100 ||
+            !campo_real(c[2], &ajuste))
+            return "uso: ocupacao;limite (1 a 100);ajuste";
+        r->tipo = REGRA_OCUPACAO;
+    } else {
+        return "regra desconhecida (temporada, dia ou ocupacao)";
+    }
+    if (ajuste < -100 || ajuste > 10000) return "ajuste fora de -100% a 10000%";
+    r->ajuste = (int32_t)(ajuste * 100 + (ajuste < 0 ? -0.5f : 0.5f));
+    r->quarto = quarto;
+    return NULL;
+}
+
+int comparar_limite(const void *a, const void *b) {
+    const RegraTarifa *x = a, *y = b;
+    return (x->limite > y->limite) - (x->limite < y->limite);
+}
+
+int guardar_regra(RegraTarifa **vetor, size_t *qtd, const RegraTarifa *r) {
+    RegraTarifa *maior = realloc(*vetor, (*qtd + 1) * sizeof(RegraTarifa));
+    if (!maior) return 0;
+    *vetor = maior;
+    maior[(*qtd)++] = *r;
+    return 1;
+}
+
+/* le tarifas.txt de novo (sem o arquivo fica so a diaria base). linha com
+   erro e avisada e fica de fora. as tabelas ja montadas sao descartadas */
+void carregar_tarifas() {
+    tarifas_esquecer_tabelas();
+    free(tarifario.regras); free(tarifario.ocupacao);
+    tarifario.regras = tarifario.ocupacao = NULL;
+    tarifario.qtd_regras = tarifario.qtd_ocupacao = 0;
+    FILE *f = fopen(ARQ_TARIFAS, "r");
+    if (!f) return;
+    char linha[256];
+    int num = 0;
+    while (fgets(linha, sizeof(linha), f)) {
+        num++;
+        char *c[TARIFA_MAX_CAMPOS];
+        size_t n = separar_campos(linha, c, TARIFA_MAX_CAMPOS);
+        if (c[0][0] == '\0' || c[0][0] == '#') continue;
+        RegraTarifa r;
+        const char *erro = regra_de_campos(c, n, &r);
+        if (!erro && r.tipo == REGRA_OCUPACAO && tarifario.qtd_ocupacao == TARIFA_MAX_OCUPACAO)
+            erro = "regras de ocupacao demais";
+        if (!erro && !(r.tipo == REGRA_OCUPACAO ? guardar_regra(&tarifario.ocupacao, &tarifario.qtd_ocupacao, &r)
+                                                 : guardar_regra(&tarifario.regras, &tarifario.qtd_regras, &r)))
+            erro = "sem memoria";
+        if (erro) printf("%s, linha %d: %s\n", ARQ_TARIFAS, num, erro);
+    }
+    fclose(f);
+    qsort(tarifario.ocupacao, tarifario.qtd_ocupacao, sizeof(RegraTarifa), comparar_limite);
+}
+
+// diaria base de cada linha, de quartos.dat. as tabelas montadas antes sao descartadas
+int tarifas_carregar_quartos() {
+    tarifas_esquecer_tabelas();
+    free(tarifario.numeros); free(tarifario.base);
+    tarifario.numeros = NULL; tarifario.base = NULL;
+    tarifario.qtd_linhas = 0;
+    VisaoArquivo v;
+    int tem_quartos = abrir_visao(&v, ARQ_QUARTOS, sizeof(Quarto));
+    size_t n = tem_quartos ? v.quantidade : 0;
+    tarifario.numeros = malloc((n + 1) * sizeof(int32_t));
+    tarifario.base = malloc((n + 1) * sizeof(Centavos));
+    int ok = tarifario.numeros && tarifario.base;
+    const Quarto *qs = tem_quartos ? v.registros : NULL;
+    for (size_t i = 0; ok && i < n; ++i) {
+        tarifario.numeros[i] = qs[i].numero;
+        tarifario.base[i] = centavos_de_reais(qs[i].valorDiaria);
+    }
+    if (tem_quartos) fechar_visao(&v);
+    if (ok) {
+        tarifario.numeros[n] = 0;
+        tarifario.base[n] = 0;
+        tarifario.qtd_linhas = n;
+    }
+    tarifario.qtd_quartos = idx_quartos.quantidade;
+    return ok;
+}
+
+// linha das tabelas do quarto, ou -1 se ele nao existe (ou faltou memoria)
+long tarifa_linha(int32_t numero) {
+    long pos = indice_buscar(&idx_quartos, numero);
+    if (pos < 0) return -1;
+    // quarto cadastrado depois das tabelas: relidas as diarias
+    if ((size_t)pos >= tarifario.qtd_linhas && !tarifas_carregar_quartos()) return -1;
+    return (size_t)pos < tarifario.qtd_linhas ? pos : -1;
+}
+
+// soma dos ajustes de temporada e dia da semana que valem no dia para o quarto (0 = regras de todos)
+int32_t ajuste_regras(Data dia, int32_t quarto) {
+    int a, m, d;
+    civil_de_data(dia, &a, &m, &d);
+    int32_t mmdd = m * 100 + d;
+    int semana = (int)(((dia % 7) + 11) % 7); // 01/01/1970 foi quinta
+    int32_t soma = 0;
+    for (size_t i = 0; i < tarifario.qtd_regras; ++i) {
+        const RegraTarifa *r = &tarifario.regras[i];
+        if (r->quarto != quarto) continue;
+        int vale;
+        if (r->tipo == REGRA_DIA) vale = r->semana == semana;
+        else if (!r->anual) vale = dia >= r->de && dia <= r->ate;
+        else if (r->de <= r->ate) vale = mmdd >= r->de && mmdd <= r->ate;
+        else vale = mmdd >= r->de || mmdd <= r->ate;
+        if (vale) soma += r->ajuste;
+    }
+    return soma;
+}
+
+int quarto_tem_regras(int32_t numero) {
+    for (size_t i = 0; numero != 0 && i < tarifario.qtd_regras; ++i)
+        if (tarifario.regras[i].quarto == numero) return 1;
+    return 0;
+}
+
+Centavos preco_noite(Centavos base, int32_t ajuste) {
+    int64_t fator = 10000 + (int64_t)ajuste;
+    return fator > 0 ? (base * fator + 5000) / 10000 : 0;
+}
+
+// 1 + maior regra de ocupacao atingida com vendidas quartos na noite (0 = nenhuma)
+uint8_t faixa_ocupacao(int32_t vendidas) {
+    uint8_t faixa = 0;
+    for (size_t i = 0; i < tarifario.qtd_ocupacao; ++i)
+        if ((int64_t)vendidas * 100 >= (int64_t)tarifario.ocupacao[i].limite * (int64_t)tarifario.qtd_quartos)
+            faixa = (uint8_t)(i + 1);
+    return faixa;
+}
+
+// soma as noites da estadia que caem no ano. a primeira noite que mudou de faixa invalida os prefixos dali em diante
+void vendas_somar(TabelaAno *t, const Estadia *e) {
+    Data a = e->dataEntrada > t->inicio ? e->dataEntrada : t->inicio;
+    Data b = e->dataEntrada + e->qtdDiarias;
+    if (b > t->inicio + t->dias) b = t->inicio + t->dias;
+    for (Data d = a; d < b; ++d) {
+        int i = (int)(d - t->inicio);
+        uint8_t faixa = faixa_ocupacao(++t->vendidas[i]);
+        if (faixa != t->faixa[i]) {
+            t->faixa[i] = faixa;
+            if (i < t->valido_ate) t->valido_ate = i;
+        }
+    }
+}
+
+typedef struct {
+    const VarreduraEstadias *vr;
+    Data inicio;
+    int dias;
+    int32_t *parciais;  // dias contadores por pedaco
+} ContagemVendas;
+
+typedef struct {
+    Data inicio;
+    int dias;
+    int32_t *vendidas;
+} VendasPedaco;
+
+void contar_venda(const Estadia *e, void *ctx) {
+    VendasPedaco *p = ctx;
+    Data a = e->dataEntrada > p->inicio ? e->dataEntrada : p->inicio;
+    Data b = e->dataEntrada + e->qtdDiarias;
+    if (b > p->inicio + p->dias) b = p->inicio + p->dias;
+    for (Data d = a; d < b; ++d) p->vendidas[d - p->inicio]++;
+}
+
+void contar_vendas_pedaco(size_t k, void *ctx) {
+    ContagemVendas *c = ctx;
+    VendasPedaco p = { c->inicio, c->dias, c->parciais + k * (size_t)c->dias };
+    varredura_pedaco(c->vr, k, contar_venda, &p);
+}
+
+// quartos vendidos por noite do ano, com todas as estadias (um contador por pedaco, somados no fim)
+int contar_vendas(TabelaAno *t) {
+    VarreduraEstadias vr;
+    if (!varredura_abrir(&vr)) return 0;
+    ContagemVendas c = { &vr, t->inicio, t->dias, calloc((vr.qtd ? vr.qtd : 1) * (size_t)t->dias, sizeof(int32_t)) };
+    if (c.parciais) {
+        varrer_em_paralelo(vr.qtd, contar_vendas_pedaco, &c);
+        for (size_t k = 0; k < vr.qtd; ++k)
+            for (int d = 0; d < t->dias; ++d) t->vendidas[d] += c.parciais[k * (size_t)t->dias + d];
+        free(c.parciais);
+        t->geracao = vr.geracao;
+        t->contadas = vr.tem_quentes ? vr.v.quantidade : 0;
+    }
+    varredura_fechar(&vr);
+    if (!c.parciais) return 0;
+    for (int d = 0; d < t->dias; ++d) t->faixa[d] = faixa_ocupacao(t->vendidas[d]);
+    return 1;
+}
+
+// refaz os prefixos de todas as linhas a partir de valido_ate
+void tabela_refazer(TabelaAno *t) {
+    if (t->valido_ate >= t->dias) return;
+    size_t largura = (size_t)t->dias + 1;
+    for (size_t s = 0; s < tarifario.qtd_linhas; ++s) {
+        Centavos *p = &t->prefixo[s * largura];
+        Centavos base = tarifario.base[s];
+        int proprias = quarto_tem_regras(tarifario.numeros[s]);
+        for (int d = t->valido_ate; d < t->dias; ++d) {
+            int32_t ajuste = t->ajuste[d];
+            if (t->faixa[d]) ajuste += tarifario.ocupacao[t->faixa[d] - 1].ajuste;
+            if (proprias) ajuste += ajuste_regras(t->inicio + d, tarifario.numeros[s]);
+            p[d + 1] = p[d] + preco_noite(base, ajuste);
+        }
+    }
+    t->valido_ate = t->dias;
+}
+
+TabelaAno *tabela_montar(int ano) {
+    TabelaAno *t = calloc(1, sizeof(TabelaAno));
+    if (!t) return NULL;
+    t->ano = ano;
+    t->inicio = data_de_civil(ano, 1, 1);
+    t->dias = (int)(data_de_civil(ano + 1, 1, 1) - t->inicio);
+    t->ajuste = malloc((size_t)t->dias * sizeof(int32_t));
+    t->faixa = calloc((size_t)t->dias, 1);
+    t->prefixo = calloc((tarifario.qtd_linhas + 1) * ((size_t)t->dias + 1), sizeof(Centavos));
+    if (tarifario.qtd_ocupacao > 0) t->vendidas = calloc((size_t)t->dias, sizeof(int32_t));
+    int ok = t->ajuste && t->faixa && t->prefixo && (tarifario.qtd_ocupacao == 0 || t->vendidas);
+    if (ok && tarifario.qtd_ocupacao > 0) ok = contar_vendas(t);
+    if (!ok) { tabela_liberar(t); return NULL; }
+    for (int d = 0; d < t->dias; ++d) t->ajuste[d] = ajuste_regras(t->inicio + d, 0);
+    tabela_refazer(t);
+    return t;
+}
+
+/* poe as estadias novas de estadias.dat na ocupacao das tabelas. depois de
+   uma compactacao (ja vista por este terminal) as posicoes mudaram e as
+   tabelas sao montadas de novo */
+void tarifas_atualizar() {
+    if (tarifario.qtd_ocupacao == 0 || tarifario.qtd_anos == 0) return;
+    int precisa = 0;
+    for (size_t i = 0; i < tarifario.qtd_anos; ++i)
+        precisa |= tarifario.anos[i]->geracao < geracao_vista ||
+                   (long)tarifario.anos[i]->contadas < idx_estadias.registros;
+    if (!precisa) return;
+    VisaoArquivo v;
+    int tem_quentes = abrir_visao(&v, ARQ_ESTADIAS, sizeof(Estadia));
+    uint32_t geracao = tem_quentes ? ((const CabecalhoArquivo *)v.base)->geracao : 0;
+    size_t qtd = tem_quentes ? v.quantidade : 0;
+    const Estadia *es = tem_quentes ? v.registros : NULL;
+    for (size_t i = tarifario.qtd_anos; i-- > 0;) {
+        TabelaAno *t = tarifario.anos[i];
+        if (t->geracao != geracao || qtd < t->contadas) {
+            tabela_liberar(t);
+            memmove(&tarifario.anos[i], &tarifario.anos[i + 1], (tarifario.qtd_anos - i - 1) * sizeof(TabelaAno *));
+            tarifario.qtd_anos--;
+            continue;
+        }
+        for (size_t j = t->contadas; j < qtd; ++j) vendas_somar(t, &es[j]);
+        t->contadas = qtd;
+    }
+    if (tem_quentes) fechar_visao(&v);
+}
+
+// tabela do ano com os prefixos em dia; monta se ainda nao existe. NULL se faltou memoria
+TabelaAno *tabela_do_ano(int ano) {
+    for (size_t i = 0; i < tarifario.qtd_anos; ++i) {
+        if (tarifario.anos[i]->ano != ano) continue;
+        tabela_refazer(tarifario.anos[i]);
+        return tarifario.anos[i];
+    }
+    TabelaAno *t = tabela_montar(ano);
+    if (!t) return NULL;
+    if (tarifario.qtd_anos == TARIFA_ANOS) {
+        tabela_liberar(tarifario.anos[0]);
+        memmove(&tarifario.anos[0], &tarifario.anos[1], (TARIFA_ANOS - 1) * sizeof(TabelaAno *));
+        tarifario.qtd_anos--;
+    }
+    tarifario.anos[tarifario.qtd_anos++] = t;
+    return t;
+}
+
+/* preco das noites [inicio, fim) no quarto: uma subtracao por ano tocado.
+   retorna 0 se o quarto nao existe ou faltou memoria */
+int tarifa_periodo(int32_t numero, Data inicio, Data fim, Centavos *total) {
+    *total = 0;
+    long s = tarifa_linha(numero);
+    if (s < 0) return 0;
+    tarifas_atualizar();
+    while (inicio < fim) {
+        int ano, m, d;
+        civil_de_data(inicio, &ano, &m, &d);
+        const TabelaAno *t = tabela_do_ano(ano);
+        if (!t) return 0;
+        Data ate = fim < t->inicio + t->dias ? fim : t->inicio + t->dias;
+        const Centavos *p = &t->prefixo[(size_t)s * ((size_t)t->dias + 1)];
+        *total += p[ate - t->inicio] - p[inicio - t->inicio];
+        inicio = ate;
+    }
+    return 1;
+}
+
+// preco cobrado na baixa: as noites de entrada ate entrada + qtdDiarias (sem tabela: diaria base fixa)
+Centavos preco_estadia(const Estadia *e, const Quarto *q) {
+    Centavos total;
+    if (!tarifa_periodo(e->numeroQuarto, e->dataEntrada, e->dataEntrada + e->qtdDiarias, &total))
+        total = centavos_de_reais(q->valorDiaria) * e->qtdDiarias;
+    return total;
+}
+
+// opcao 20: rele tarifas.txt e mostra o preco de cada noite de um periodo no quarto
+void cotar_estadia() {
+    carregar_tarifas();
+    printf("%lu regras em %s.\n", (unsigned long)(tarifario.qtd_regras + tarifario.qtd_ocupacao), ARQ_TARIFAS);
+    printf("Numero do quarto: ");
+    int numero;
+    if (scanf("%d", &numero) != 1) { printf("Numero invalido.\n"); limpar_buffer_scanf(); return; }
+    limpar_buffer_scanf();
+    Data entrada, saida;
+    if (!ler_data("Data de entrada", &entrada)) return;
+    if (!ler_data("Data de saida", &saida)) return;
+    int dias = diff_days(entrada, saida);
+    if (dias <= 0) { printf("Periodo invalido (saida deve ser apos entrada).\n"); return; }
+    Centavos total;
+    if (!tarifa_periodo(numero, entrada, saida, &total)) { printf("Quarto nao encontrado.\n"); return; }
+    char valor[TAM_REAIS];
+    for (Data d = entrada; d < saida; ++d) {
+        int a, m, dia;
+        Centavos noite;
+        civil_de_data(d, &a, &m, &dia);
+        tarifa_periodo(numero, d, d + 1, &noite);
+        printf("%02d/%02d/%04d (%s): R$ %s\n", dia, m, a, dias_semana[((d % 7) + 11) % 7], formatar_centavos(noite, valor));
+    }
+    printf("Total (%d diarias): R$ %s\n", dias, formatar_centavos(total, valor));
+}
+
+//disponibilidade e calendario (somente leitura)
+
+typedef struct {
+    int numero;
+    int capacidade;
+    Centavos diaria; // base
+    Centavos total;  // o periodo pelas tarifas
+} QuartoLivre;
+
+int comparar_quarto_livre(const void *a, const void *b) {
+    const QuartoLivre *x = a, *y = b;
+    if (x->total != y->total) return x->total < y->total ? -1 : 1;
+    return (x->numero > y->numero) - (x->numero < y->numero);
+}
+
+/* todos os quartos com capacidade >= qtd livres em [entrada, saida), do
+   total mais barato ao mais caro. nao grava nada (mas pode montar tabelas
+   de tarifa). retorna o vetor (free) ou NULL se nenhum; qtd_livres recebe
+   o tamanho */
+QuartoLivre *quartos_livres(int qtd, Data entrada, Data saida, size_t *qtd_livres) {
+    *qtd_livres = 0;
+    size_t k0 = balde_limite_inferior(qtd), total = 0;
+    for (size_t k = k0; k < qtd_baldes; ++k) total += baldes[k].qtd;
+    if (total == 0) return NULL;
+    QuartoLivre *livres = malloc(total * sizeof(QuartoLivre));
+    if (!livres) return NULL;
+    size_t n = 0;
+    for (size_t k = k0; k < qtd_baldes; ++k) {
+        const BaldeCapacidade *b = &baldes[k];
+        for (size_t i = 0; i < b->qtd; ++i) {
+            if (!periodo_livre(b->itens[i].numero, entrada, saida)) continue;
+            QuartoLivre l = { b->itens[i].numero, b->capacidade, centavos_de_reais(b->itens[i].valorDiaria), 0 };
+            if (!tarifa_periodo(l.numero, entrada, saida, &l.total)) l.total = l.diaria * (saida - entrada);
+            livres[n++] = l;
+        }
+    }
+    if (n == 0) { free(livres); return NULL; }
+    qsort(livres, n, sizeof(QuartoLivre), comparar_quarto_livre);
+    *qtd_livres = n;
+    return livres;
+}
+
+void consultar_disponibilidade() {
+    int qtd;
+    Data entrada, saida;
+    printf("Quantidade de hospedes: ");
+    if (scanf("%d", &qtd) != 1) { printf("Quantidade invalida.\n"); limpar_buffer_scanf(); return; }
+    limpar_buffer_scanf();
+    if (!ler_data("Data de entrada", &entrada)) return;
+    if (!ler_data("Data de saida", &saida)) return;
+    int dias = diff_days(entrada, saida);
+    if (dias <= 0) { printf("Periodo invalido (saida deve ser apos entrada).\n"); return; }
+
+    size_t n;
+    QuartoLivre *livres = quartos_livres(qtd, entrada, saida, &n);
+    if (!livres) { printf("Nenhum quarto disponivel para o periodo e capacidade.\n"); return; }
+    char diaria[TAM_REAIS], total[TAM_REAIS];
+    for (size_t i = 0; i < n; ++i) {
+        printf("Quarto %d | Capacidade: %d | Diaria base: R$ %s | Total (%d diarias): R$ %s\n",
+               livres[i].numero, livres[i].capacidade, formatar_centavos(livres[i].diaria, diaria), dias,
+               formatar_centavos(livres[i].total, total));
+    }
+    printf("%lu quartos disponiveis.\n", (unsigned long)n);
+    free(livres);
+}
+
+// uma linha por quarto, uma coluna por dia do mes ('#' ocupado, '.' livre)
+void mostrar_calendario(int mes, int ano) {
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_QUARTOS, sizeof(Quarto)) || v.quantidade == 0) {
+        printf("Nenhum quarto cadastrado.\n"); fechar_visao(&v); return;
+    }
+    Data inicio = data_de_civil(ano, mes, 1);
+    int dias = diff_days(inicio, mes < 12 ? data_de_civil(ano, mes + 1, 1) : data_de_civil(ano + 1, 1, 1));
+    printf("Ocupacao em %02d/%04d ('#' ocupado, '.' livre)\n", mes, ano);
+    printf("%-8s", "");
+    for (int d = 1; d <= dias; ++d) putchar(d >= 10 ? '0' + d / 10 : ' ');
+    printf("\n%-8s", "Quarto");
+    for (int d = 1; d <= dias; ++d) putchar('0' + d % 10);
+    printf("\n");
+    const Quarto *qs = v.registros;
+    for (size_t i = 0; i < v.quantidade; ++i) {
+        if (indice_buscar(&idx_quartos, qs[i].numero) != (long)i) continue;
+        const AgendaQuarto *a = agenda_do_quarto(qs[i].numero, 0);
+        printf("%-8d", qs[i].numero);
+        for (int d = 0; d < dias; ++d) putchar(agenda_dia_ocupado(a, inicio + d) ? '#' : '.');
+        printf("\n");
+    }
+    fechar_visao(&v);
+}
+
+void mostrar_calendario_menu() {
+    int mes, ano;
+    printf("Mes e ano (ex: 7 2026): ");
+    if (scanf("%d %d", &mes, &ano) != 2 || mes < 1 || mes > 12 || ano < 1900 || ano > 9999) {
+        printf("Mes invalido.\n"); limpar_buffer_scanf(); return;
+    }
+    limpar_buffer_scanf();
+    mostrar_calendario(mes, ano);
+}
+
+//fidelidade: agregado de diarias por cliente
+
+/* fidelidade.dat tem um registro por cliente com estadia, indexado por
+   idx_fidelidade. cadastrar_estadia e dar_baixa_estadia atualizam o registro
+   no lugar, na mesma transacao da estadia, entao consultar pontos e ler um
+   registro. --verificar-pontos refaz o arquivo a partir de estadias.dat
+   (depois de uma queda do sistema no meio de um lote, por exemplo). */
+#define PONTOS_POR_DIARIA 10
+
+Indice idx_fidelidade;
+
+// soma os deltas no registro do cliente, criando o registro se preciso
+int fidelidade_somar(int codCliente, int diarias, int finalizadas, int estadias) {
+    Fidelidade fd;
+    long pos = indice_buscar(&idx_fidelidade, codCliente);
+    if (pos < 0) {
+        // cliente novo no agregado: outro terminal pode ter acabado de criar
+        if (!travar_anexo(ARQ_FIDELIDADE)) return 0;
+        indice_ler_cauda(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade), NULL);
+        pos = indice_buscar(&idx_fidelidade, codCliente);
+        int ok = 1;
+        if (pos < 0) {
+            memset(&fd, 0, sizeof(fd));
+            fd.codCliente = codCliente;
+            fd.totalDiarias = diarias;
+            fd.diariasFinalizadas = finalizadas;
+            fd.estadias = estadias;
+            ok = anexar_registro(&idx_fidelidade, ARQ_FIDELIDADE, &fd, sizeof(Fidelidade));
+        }
+        destravar_anexo(ARQ_FIDELIDADE);
+        if (pos < 0) return ok;
+    }
+    // soma sobre o valor lido com o registro travado
+    if (!travar_registro(ARQ_FIDELIDADE, pos)) return 0;
+    int ok = ler_registro(ARQ_FIDELIDADE, sizeof(Fidelidade), pos, &fd);
+    if (ok) {
+        fd.totalDiarias += diarias;
+        fd.diariasFinalizadas += finalizadas;
+        fd.estadias += estadias;
+        ok = gravar_registro(ARQ_FIDELIDADE, &fd, sizeof(Fidelidade), pos);
+    }
+    destravar_registro(ARQ_FIDELIDADE, pos);
+    return ok;
+}
+
+typedef struct {
+    Indice por_cliente;
+    Fidelidade *tabela;
+    size_t qtd, cap;
+} CalculoFidelidade;
+
+// registro do cliente na tabela, criado zerado na primeira vez. NULL se faltou memoria
+Fidelidade *fidelidade_do_cliente(CalculoFidelidade *c, int32_t codCliente) {
+    long k = indice_buscar(&c->por_cliente, codCliente);
+    if (k < 0) {
+        if (c->qtd == c->cap) {
+            size_t nova_cap = c->cap ? c->cap * 2 : 64;
+            Fidelidade *nova = realloc(c->tabela, nova_cap * sizeof(Fidelidade));
+            if (!nova) return NULL;
+            c->tabela = nova; c->cap = nova_cap;
+        }
+        k = (long)c->qtd++;
+        memset(&c->tabela[k], 0, sizeof(Fidelidade));
+        c->tabela[k].codCliente = codCliente;
+        indice_inserir(&c->por_cliente, codCliente, k);
+    }
+    return &c->tabela[k];
+}
+
+void somar_fidelidade(const Estadia *e, void *ctx) {
+    Fidelidade *fd = fidelidade_do_cliente(ctx, e->codCliente);
+    if (!fd) return;
+    fd->totalDiarias += e->qtdDiarias;
+    if (!e->ativo) fd->diariasFinalizadas += e->qtdDiarias;
+    fd->estadias++;
+}
+
+void somar_parcial(CalculoFidelidade *c, const Fidelidade *parcial) {
+    Fidelidade *fd = fidelidade_do_cliente(c, parcial->codCliente);
+    if (!fd) return;
+    fd->totalDiarias += parcial->totalDiarias;
+    fd->diariasFinalizadas += parcial->diariasFinalizadas;
+    fd->estadias += parcial->estadias;
+}
+
+/* fidelidade_somar de muitos clientes de uma vez (importacao), na
+   transacao aberta e com fidelidade.dat inteiro travado (fim e registros):
+   cada registro e lido uma vez do arquivo e os clientes novos vao num anexo
+   so. nada antes na transacao pode ter gravado em fidelidade.dat */
+int fidelidade_somar_deltas(const Fidelidade *deltas, size_t n) {
+    if (n == 0) return 1;
+    indice_ler_cauda(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade), NULL);
+    Fidelidade *novos = malloc(n * sizeof(Fidelidade));
+    if (!novos) return 0;
+    size_t qtd_novos = 0;
+    FILE *f = fopen(ARQ_FIDELIDADE, "rb");
+    int ok = 1;
+    for (size_t i = 0; ok && i < n; ++i) {
+        long pos = indice_buscar(&idx_fidelidade, deltas[i].codCliente);
+        if (pos < 0) { novos[qtd_novos++] = deltas[i]; continue; }
+        Fidelidade fd;
+        ok = f != NULL && fseek(f, deslocamento_registro(pos, sizeof(Fidelidade)), SEEK_SET) == 0 &&
+             fread(&fd, sizeof(fd), 1, f) == 1;
+        if (ok) {
+            fd.totalDiarias += deltas[i].totalDiarias;
+            fd.diariasFinalizadas += deltas[i].diariasFinalizadas;
+            fd.estadias += deltas[i].estadias;
+            ok = gravar_registro(ARQ_FIDELIDADE, &fd, sizeof(Fidelidade), pos);
+        }
+    }
+    if (f) fclose(f);
+    if (ok && qtd_novos > 0) ok = anexar_registros(&idx_fidelidade, ARQ_FIDELIDADE, novos, qtd_novos, sizeof(Fidelidade));
+    free(novos);
+    return ok;
+}
+
+typedef struct {
+    const VarreduraEstadias *vr;
+    CalculoFidelidade *parciais; // um por pedaco
+} CalculoParalelo;
+
+void somar_fidelidade_pedaco(size_t k, void *ctx) {
+    CalculoParalelo *c = ctx;
+    varredura_pedaco(c->vr, k, somar_fidelidade, &c->parciais[k]);
+}
+
+/* calcula o agregado do zero com uma passada nas estadias (arquivadas e
+   estadias.dat), um pedaco por fio. devolve o vetor (um por cliente, na
+   ordem da primeira estadia) e a quantidade */
+Fidelidade *fidelidade_calcular(size_t *qtd) {
+    CalculoFidelidade c;
+    memset(&c, 0, sizeof(c));
+    *qtd = 0;
+    VarreduraEstadias vr;
+    if (!varredura_abrir(&vr)) return NULL;
+    // cada pedaco soma no seu agregado; os parciais sao juntados na ordem dos pedacos
+    CalculoParalelo cp = { &vr, calloc(vr.qtd ? vr.qtd : 1, sizeof(CalculoFidelidade)) };
+    if (cp.parciais) {
+        varrer_em_paralelo(vr.qtd, somar_fidelidade_pedaco, &cp);
+        for (size_t k = 0; k < vr.qtd; ++k) {
+            CalculoFidelidade *p = &cp.parciais[k];
+            for (size_t i = 0; i < p->qtd; ++i) somar_parcial(&c, &p->tabela[i]);
+            free(p->tabela);
+            indice_liberar(&p->por_cliente);
+        }
+        free(cp.parciais);
+    }
+    varredura_fechar(&vr);
+    indice_liberar(&c.por_cliente);
+    *qtd = c.qtd;
+    return c.tabela;
+}
+
+// regrava fidelidade.dat inteiro (ao lado e renomeia, como na conversao)
+int fidelidade_regravar(const Fidelidade *tabela, size_t qtd) {
+    recuperar_diario(); // o que esta no diario e para o arquivo antigo
+    char novo_nome[64];
+    snprintf(novo_nome, sizeof(novo_nome), "%s.novo", ARQ_FIDELIDADE);
+    FILE *f = fopen(novo_nome, "wb");
+    if (!f) return 0;
+    CabecalhoArquivo cab;
+    novo_cabecalho(&cab, ARQ_FIDELIDADE, sizeof(Fidelidade));
+    cab.quantidade = (uint32_t)qtd;
+    int ok = fwrite(&cab, sizeof(cab), 1, f) == 1 &&
+             (qtd == 0 || fwrite(tabela, sizeof(Fidelidade), qtd, f) == qtd) &&
+             descarregar_arquivo(f);
+    if (fclose(f) != 0) ok = 0;
+    remove(ARQ_FIDELIDADE);
+    if (!ok || rename(novo_nome, ARQ_FIDELIDADE) != 0) { remove(novo_nome); return 0; }
+    med_bytes_gravados += sizeof(cab) + qtd * sizeof(Fidelidade);
+    indice_carregar(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade));
+    return 1;
+}
+
+/* compara fidelidade.dat com o calculado a partir das estadias e refaz o
+   arquivo se houver diferenca. retorna quantos clientes divergiam */
+long verificar_fidelidade() {
+    size_t qtd;
+    Fidelidade *tabela = fidelidade_calcular(&qtd);
+    long divergentes = 0;
+    for (size_t i = 0; i < qtd; ++i) {
+        Fidelidade gravado;
+        if (!ler_registro(ARQ_FIDELIDADE, sizeof(Fidelidade), indice_buscar(&idx_fidelidade, tabela[i].codCliente), &gravado) ||
+            memcmp(&gravado, &tabela[i], sizeof(Fidelidade)) != 0)
+            divergentes++;
+    }
+    // registros de clientes que nem tem mais estadia
+    if ((long)idx_fidelidade.quantidade > (long)qtd) divergentes += (long)idx_fidelidade.quantidade - (long)qtd;
+    if (divergentes > 0 && !fidelidade_regravar(tabela, qtd))
+        printf("Erro ao regravar %s.\n", ARQ_FIDELIDADE);
+    free(tabela);
+    return divergentes;
+}
+
+// carrega o indice; se o agregado ainda nao existe e ha estadias, monta do zero
+void carregar_fidelidade() {
+    indice_carregar(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade));
+    FILE *f = fopen(ARQ_FIDELIDADE, "rb");
+    if (f) { fclose(f); return; }
+    if (!ha_estadias()) return;
+    size_t qtd;
+    Fidelidade *tabela = fidelidade_calcular(&qtd);
+    if (fidelidade_regravar(tabela, qtd))
+        printf("%s criado a partir de %s (%lu clientes).\n", ARQ_FIDELIDADE, ARQ_ESTADIAS, (unsigned long)qtd);
+    free(tabela);
+}
+
+// estadia lida da cauda do arquivo: as ativas entram na agenda do quarto
+void agendar_estadia_nova(const void *reg, long pos, void *ctx) {
+    (void)pos; (void)ctx;
+    const Estadia *e = reg;
+    if (e->ativo == 1) agenda_inserir(e);
+}
+
+/* estadias.dat foi compactado por outro terminal: as posicoes mudaram,
+   entao indice e agendas sao montados de novo */
+void recarregar_estadias() {
+    indice_carregar(&idx_estadias, ARQ_ESTADIAS, sizeof(Estadia));
+    liberar_agendas();
+    carregar_agendas();
+}
+
+/* poe as agendas em dia com o que outros terminais gravaram: estadias novas
+   pela cauda do arquivo e, se houve baixa de outro terminal, tudo de novo */
+void sincronizar_estadias() {
+    CabecalhoArquivo cab;
+    FILE *f = abrir_dados(ARQ_ESTADIAS, sizeof(Estadia), &cab);
+    if (!f) return;
+    fclose(f);
+    if (cab.geracao != geracao_vista) {
+        recarregar_estadias();
+        return;
+    }
+    if (cab.alteracoes != alteracoes_vistas) {
+        liberar_agendas();
+        carregar_agendas();
+    }
+    indice_ler_cauda(&idx_estadias, ARQ_ESTADIAS, sizeof(Estadia), agendar_estadia_nova);
+}
+
+/* conta uma baixa no cabecalho de estadias.dat para os outros terminais.
+   chamar com o fim do arquivo travado */
+int registrar_alteracao_estadias() {
+    CabecalhoArquivo cab;
+    if (!cabecalho_atual(ARQ_ESTADIAS, sizeof(Estadia), &cab)) return 0;
+    if (cab.alteracoes == alteracoes_vistas) alteracoes_vistas++;
+    cab.alteracoes++;
+    return transacao_gravar(ARQ_ESTADIAS, 0, &cab, sizeof(cab));
+}
+
+/* grava uma estadia para o cliente e periodo de e (codCliente, dataEntrada,
+   dataSaida), escolhendo o quarto pela politica_alocacao. preenche codigo,
+   quarto e diarias. retorna NULL ou a mensagem de erro.
+   reserva otimista: o quarto e escolhido sem trava nenhuma; depois, com o
+   fim de estadias.dat travado, as agendas sao postas em dia e a escolha e
+   conferida. se outro terminal pegou o quarto nesse meio tempo a escolha e
+   refeita ja com a agenda nova, e a gravacao acontece antes de soltar a trava */
+const char *registrar_estadia(Estadia *e, int qtd) {
+    if (indice_buscar(&idx_clientes, e->codCliente) < 0) sincronizar_clientes();
+    if (idx_clientes.registros == 0) return "Nenhum cliente cadastrado.";
+    if (indice_buscar(&idx_clientes, e->codCliente) < 0) return "Cliente nao encontrado.";
+    int dias = diff_days(e->dataEntrada, e->dataSaida);
+    if (dias <= 0) return "Periodo invalido (saida deve ser apos entrada).";
+    e->qtdDiarias = (int16_t)dias;
+    e->ativo = 1;
+
+    // procurar quarto disponivel (capacidade >= qtd e sem periodo conflito)
+    sincronizar_quartos();
+    if (idx_quartos.registros == 0) return "Nenhum quarto cadastrado.";
+    Quarto qtmp;
+    if (!alocar_quarto(qtd, e->dataEntrada, e->dataSaida, &qtmp)) {
+        // pode ser agenda velha: confere de novo depois de sincronizar
+        sincronizar_estadias();
+        if (!alocar_quarto(qtd, e->dataEntrada, e->dataSaida, &qtmp)) return "Nenhum quarto disponivel para o periodo e capacidade.";
+    }
+
+    if (!travar_anexo(ARQ_ESTADIAS)) return "Erro ao travar arquivo de estadias.";
+    sincronizar_estadias();
+    if (!periodo_livre(qtmp.numero, e->dataEntrada, e->dataSaida) &&
+        !alocar_quarto(qtd, e->dataEntrada, e->dataSaida, &qtmp)) {
+        destravar_anexo(ARQ_ESTADIAS);
+        return "Nenhum quarto disponivel para o periodo e capacidade.";
+    }
+    e->numeroQuarto = qtmp.numero;
+    e->codigo = gerar_codigo_estadia();
+    // estadia, agregado e quarto numa transacao so: ou vai tudo ou nada
+    transacao_iniciar();
+    const char *erro = NULL;
+    if (!anexar_publicando(ALT_ESTADIA, &idx_estadias, ARQ_ESTADIAS, e, 1, sizeof(Estadia))) erro = "Erro ao gravar arquivo de estadias.";
+    destravar_anexo(ARQ_ESTADIAS); // so solta no commit
+    if (!erro && !fidelidade_somar(e->codCliente, e->qtdDiarias, 0, 1))
+        erro = "Erro ao atualizar pontos de fidelidade.";
+    // Na lgica ideal, o quarto s ficaria ocupado se fosse uma estadia aberta,
+    // mas mantemos a lgica original para evitar mudar as regras do seu trabalho.
+    if (!erro && !atualizar_quarto(e->numeroQuarto, 1)) erro = "Erro ao atualizar arquivo de quartos.";
+    if (erro) transacao_descartar();
+    else if (!transacao_confirmar()) erro = "Erro ao gravar o diario.";
+    if (erro) {
+        // os indices ja tinham a estadia (e talvez o cliente no agregado)
+        recarregar_estadias();
+        indice_carregar(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade));
+        return erro;
+    }
+    agenda_inserir(e);
+    return NULL;
+}
+
+void cadastrar_estadia() {
+    Estadia e;
+    int gerado = e.codigo = gerar_codigo_estadia();
+    printf("Codigo gerado para estadia: %d\n", e.codigo);
+
+    printf("Codigo do cliente: ");
+    int temp_cod;
+    if (scanf("%d", &temp_cod) != 1) {
+        printf("Codigo do cliente invalido.\n");
+        limpar_buffer_scanf();
+        return;
+    }
+    e.codCliente = temp_cod;
+
+    // verificar cliente existe (consulta so o indice, sem abrir o arquivo)
+    if (indice_buscar(&idx_clientes, e.codCliente) < 0) sincronizar_clientes();
+    if (idx_clientes.registros == 0) { printf("Nenhum cliente cadastrado.\n"); return; }
+    int cliente_ok = indice_buscar(&idx_clientes, e.codCliente) >= 0;
+    if (!cliente_ok) { printf("Cliente nao encontrado.\n"); limpar_buffer_scanf(); return; }
+
+    printf("Quantidade de hospedes: ");
+    int qtd;
+    if (scanf("%d", &qtd) != 1) {
+        printf("Quantidade de hospedes invalida.\n");
+        limpar_buffer_scanf();
+        return;
+    }
+    limpar_buffer_scanf(); // Limpa o buffer APS o scanf de qtd
+
+    // NOVO: Leitura de data separada
+    Data entrada, saida;
+    if (!ler_data("Data de entrada", &entrada)) return;
+    if (!ler_data("Data de saida", &saida)) return;
+    e.dataEntrada = entrada;
+    e.dataSaida = saida;
+
+    const char *erro = registrar_estadia(&e, qtd);
+    if (erro) { printf("%s\n", erro); return; }
+    if (e.codigo != gerado) printf("Codigo alterado para %d (o gerado foi usado por outro terminal).\n", e.codigo);
+
+    printf("Estadia cadastrada! Codigo: %d | Quarto: %d | Diarias: %d\n",
+           e.codigo, e.numeroQuarto, e.qtdDiarias);
+}
+
+/* finaliza a estadia cod (ativo=0) e libera o quarto. devolve a estadia e o
+   quarto em e_out/q_out para o calculo do total. retorna NULL ou o erro */
+const char *finalizar_estadia(int cod, Estadia *e_out, Quarto *q_out) {
+    long pos = indice_buscar(&idx_estadias, cod);
+    if (pos < 0) {
+        // estadia feita em outro terminal
+        sincronizar_estadias();
+        pos = indice_buscar(&idx_estadias, cod);
+    }
+    Estadia e;
+    Quarto q;
+    // as arquivadas nao sao procuradas aqui (seria ler todos os meses): ver dar_baixa_estadia
+    if (pos < 0) return ha_estadias() ? "Estadia nao encontrada." : "Nenhuma estadia registrada.";
+
+    // com o registro travado, duas baixas da mesma estadia nao passam juntas
+    if (!travar_registro(ARQ_ESTADIAS, pos)) return "Erro ao travar arquivo de estadias.";
+    if (!ler_registro(ARQ_ESTADIAS, sizeof(Estadia), pos, &e) || e.codigo != cod) {
+        // estadias.dat foi compactado por outro terminal: as posicoes mudaram
+        destravar_registro(ARQ_ESTADIAS, pos);
+        recarregar_estadias();
+        pos = indice_buscar(&idx_estadias, cod);
+        if (pos < 0) return "Estadia nao encontrada.";
+        if (!travar_registro(ARQ_ESTADIAS, pos)) return "Erro ao travar arquivo de estadias.";
+    }
+    // estadia, cabecalho, agregado e quarto numa transacao so
+    transacao_iniciar();
+    const char *erro = NULL;
+    if (!ler_registro(ARQ_ESTADIAS, sizeof(Estadia), pos, &e) || e.codigo != cod) erro = "Estadia nao encontrada.";
+    else if (e.ativo == 0) erro = "Estadia ja finalizada.";
+    // obter valor diaria do quart
+    else if (!quarto_existe(e.numeroQuarto, &q)) erro = "Quarto nao encontrado (erro de consistencia).";
+    else {
+        *e_out = e;
+        *q_out = q;
+        // marcar estadia como finalizada e atualizar arquivo
+        e.ativo = 0;
+        if (!atualizar_estadia(e)) erro = "Erro ao atualizar arquivo de estadias.";
+    }
+    destravar_registro(ARQ_ESTADIAS, pos); // so solta no commit
+    if (!erro) {
+        if (!travar_anexo(ARQ_ESTADIAS)) erro = "Erro ao travar arquivo de estadias.";
+        else {
+            if (!registrar_alteracao_estadias()) erro = "Erro ao atualizar arquivo de estadias.";
+            destravar_anexo(ARQ_ESTADIAS);
+        }
+    }
+    if (!erro && !fidelidade_somar(e.codCliente, 0, e.qtdDiarias, 0))
+        erro = "Erro ao atualizar pontos de fidelidade.";
+    // liberar quarto
+    if (!erro && !atualizar_quarto(e.numeroQuarto, 0)) erro = "Erro ao atualizar arquivo de quartos.";
+    if (erro) {
+        transacao_descartar();
+        return erro;
+    }
+    if (!transacao_confirmar()) return "Erro ao gravar o diario.";
+    agenda_remover(&e);
+    return NULL;
+}
+
+// dar baixa em uma estadia: definir ativo=0 e liberar quarto
+void dar_baixa_estadia() {
+    printf("Codigo da estadia para dar baixa: ");
+    int cod; scanf("%d", &cod);
+    limpar_buffer_scanf(); // Limpeza de buffer
+
+    Estadia e;
+    Quarto q;
+    const char *erro = finalizar_estadia(cod, &e, &q);
+    if (erro && estadia_arquivada(cod, &e)) erro = "Estadia ja finalizada (arquivada).";
+    if (erro) { printf("%s\n", erro); return; }
+    char base[TAM_REAIS], total[TAM_REAIS];
+    printf("Total a pagar: %d diarias (base R$ %s) = R$ %s\n", e.qtdDiarias,
+           formatar_centavos(centavos_de_reais(q.valorDiaria), base), formatar_centavos(preco_estadia(&e, &q), total));
+    printf("Baixa registrada e quarto liberado.\n");
+}
+
+//compactacao de estadias.dat
+
+int comparar_para_arquivar(const void *a, const void *b) {
+    const Estadia *x = a, *y = b;
+    int32_t mx = mes_da_data(x->dataEntrada), my = mes_da_data(y->dataEntrada);
+    if (mx != my) return (mx > my) - (mx < my);
+    return (x->codigo > y->codigo) - (x->codigo < y->codigo);
+}
+
+// corta o arquivo do mes em tam bytes (blocos de uma compactacao que caiu)
+int cortar_arquivo(const char *nome, long tam) {
+    FILE *f = fopen(nome, "r+b");
+    if (!f) return 0;
+    int ok = cortar_aberto(f, tam);
+    fclose(f);
+    return ok;
+}
+
+/* acrescenta um bloco com as estadias do mes (ordenadas por codigo) e
+   descarrega. cria o arquivo e poe o mes em estadias.arq se preciso */
+int arquivar_mes(int32_t mes, const Estadia *es, size_t n, uint32_t geracao, Indice *meses, size_t *bytes) {
+    char nome[64];
+    nome_do_mes(mes, nome, sizeof(nome));
+    long valido;
+    particao_ler(mes, geracao - 1, NULL, NULL, &valido);
+    FILE *f = fopen(nome, "r+b");
+    if (f) {
+        if (fseek(f, 0, SEEK_END) != 0 || ftell(f) != valido) {
+            fclose(f);
+            if (!cortar_arquivo(nome, valido)) return 0;
+            f = fopen(nome, "r+b");
+        }
+    } else {
+        f = fopen(nome, "w+b");
+    }
+    uint8_t *corpo = malloc(n * MAX_VARINTS_ESTADIA);
+    if (!f || !corpo) { if (f) fclose(f); free(corpo); return 0; }
+    CabecalhoBloco b;
+    memcpy(b.magia, "HDGB", 4);
+    b.geracao = geracao;
+    b.qtd = (uint32_t)n;
+    b.tam = (uint32_t)bloco_codificar(es, n, mes, corpo);
+    b.soma = soma_verificacao(corpo, b.tam, 2166136261u);
+    int ok = fseek(f, 0, SEEK_END) == 0 && fwrite(&b, sizeof(b), 1, f) == 1 &&
+             fwrite(corpo, 1, b.tam, f) == b.tam && descarregar_arquivo(f);
+    if (fclose(f) != 0) ok = 0;
+    free(corpo);
+    if (!ok) return 0;
+    *bytes += sizeof(b) + b.tam;
+    med_bytes_gravados += sizeof(b) + b.tam;
+    if (indice_buscar(meses, mes) >= 0) return 1;
+    ParticaoEstadias p = { mes };
+    return anexar_registro(meses, ARQ_PARTICOES, &p, sizeof(p));
+}
+
+/* com estadias.dat inteiro travado: arquiva as finalizadas por mes, grava
+   as ativas em estadias.dat.novo com a geracao nova e troca o arquivo.
+   ate a troca, os blocos novos nao contam para ninguem */
+int compactar_travado() {
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_ESTADIAS, sizeof(Estadia))) { printf("Nenhuma estadia cadastrada.\n"); return 0; }
+    CabecalhoArquivo cab = *(const CabecalhoArquivo *)v.base;
+    const Estadia *es = v.registros;
+    size_t total = v.quantidade, nf = 0, na = 0;
+    for (size_t i = 0; i < total; ++i) nf += es[i].ativo == 0;
+    if (nf == 0) { fechar_visao(&v); printf("Nenhuma estadia finalizada para arquivar.\n"); return 1; }
+    Estadia *finalizadas = malloc(nf * sizeof(Estadia));
+    Estadia *ativas = malloc((total - nf + 1) * sizeof(Estadia));
+    if (!finalizadas || !ativas) { free(finalizadas); free(ativas); fechar_visao(&v); return 0; }
+    nf = 0;
+    for (size_t i = 0; i < total; ++i) {
+        if (es[i].ativo == 0) finalizadas[nf++] = es[i];
+        else ativas[na++] = es[i];
+    }
+    fechar_visao(&v);
+    qsort(finalizadas, nf, sizeof(Estadia), comparar_para_arquivar);
+
+    Indice meses;
+    memset(&meses, 0, sizeof(meses));
+    indice_carregar(&meses, ARQ_PARTICOES, sizeof(ParticaoEstadias));
+    uint32_t geracao = cab.geracao + 1;
+    size_t bytes = 0, qtd_meses = 0;
+    int ok = 1;
+    transacao_iniciar(); // os meses novos de estadias.arq vao num commit so
+    for (size_t i = 0; ok && i < nf;) {
+        int32_t mes = mes_da_data(finalizadas[i].dataEntrada);
+        size_t j = i;
+        while (j < nf && mes_da_data(finalizadas[j].dataEntrada) == mes) j++;
+        ok = arquivar_mes(mes, finalizadas + i, j - i, geracao, &meses, &bytes);
+        qtd_meses++;
+        i = j;
+    }
+    indice_liberar(&meses);
+    if (ok) ok = transacao_confirmar();
+    else transacao_descartar();
+
+    char novo_nome[64];
+    snprintf(novo_nome, sizeof(novo_nome), "%s.novo", ARQ_ESTADIAS);
+    FILE *f = ok ? fopen(novo_nome, "wb") : NULL;
+    if (f) {
+        cab.quantidade = (uint32_t)na;
+        cab.geracao = geracao;
+        ok = fwrite(&cab, sizeof(cab), 1, f) == 1 && (na == 0 || fwrite(ativas, sizeof(Estadia), na, f) == na) &&
+             descarregar_arquivo(f);
+        if (fclose(f) != 0) ok = 0;
+        if (ok) ok = substituir_arquivo(novo_nome, ARQ_ESTADIAS);
+        if (!ok) remove(novo_nome);
+    } else {
+        ok = 0;
+    }
+    free(finalizadas);
+    free(ativas);
+    if (!ok) { printf("Erro ao compactar %s (nada foi perdido).\n", ARQ_ESTADIAS); return 0; }
+    med_bytes_gravados += sizeof(cab) + na * sizeof(Estadia);
+    recarregar_estadias();
+    printf("Compactacao: %lu estadias finalizadas arquivadas em %lu meses (%lu bytes em vez de %lu); "
+           "%lu ativas ficaram em %s.\n", (unsigned long)nf, (unsigned long)qtd_meses, (unsigned long)bytes,
+           (unsigned long)(nf * sizeof(Estadia)), (unsigned long)na, ARQ_ESTADIAS);
+    return 1;
+}
+
+/* pode rodar com outros terminais e o servidor abertos: com todos os
+   registros e o fim de estadias.dat travados ninguem anexa nem da baixa
+   durante a compactacao. as travas seguem a ordem da baixa (registros
+   antes do fim), senao uma baixa em outro processo pode ficar esperando
+   por esta e esta por ela. quem so le continua com a visao do arquivo
+   antigo; quem grava ve a geracao nova no cabecalho e recarrega o indice.
+   retorna 1 se deu certo */
+int compactar_estadias() {
+    if (!travar_todos_registros(ARQ_ESTADIAS)) { printf("Erro ao travar arquivo de estadias.\n"); return 0; }
+    if (!travar_anexo(ARQ_ESTADIAS)) {
+        destravar_todos_registros(ARQ_ESTADIAS);
+        printf("Erro ao travar arquivo de estadias.\n");
+        return 0;
+    }
+    recuperar_diario(); // baixa de um terminal que caiu vai para o arquivo antigo antes
+    int ok = compactar_travado();
+    destravar_anexo(ARQ_ESTADIAS);
+    destravar_todos_registros(ARQ_ESTADIAS);
+    return ok;
+}
+
+
+//juncao cliente <-> estadia
+
+/* juncao por hash em duas fases: uma passada em clientes.dat monta o
+   conjunto de codigos que passam no filtro (um Indice usado como conjunto,
+   codigo -> posicao do cliente) e depois uma passada em estadias.dat consulta
+   esse conjunto para cada estadia. custo clientes + estadias em vez de
+   clientes x estadias */
+typedef int (*FiltroCliente)(const Cliente *c, const void *ctx);
+
+// retorna 0 se clientes.dat nao pode ser lido
+int selecionar_clientes(Indice *conjunto, FiltroCliente filtro, const void *ctx) {
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_CLIENTES, sizeof(Cliente))) return 0;
+    const Cliente *cs = v.registros;
+    for (size_t i = 0; i < v.quantidade; ++i) {
+        if (filtro(&cs[i], ctx) && indice_buscar(conjunto, cs[i].codigo) < 0)
+            indice_inserir(conjunto, cs[i].codigo, (long)i);
+    }
+    fechar_visao(&v);
+    return 1;
+}
+
+// o conjunto so e lido: pode ser consultado por varios fios ao mesmo tempo
+int cliente_no_conjunto(const Estadia *e, const void *ctx) {
+    return indice_buscar(ctx, e->codCliente) >= 0;
+}
+
+/* chama acao para cada estadia cujo cliente esta no conjunto, arquivadas
+   ou nao. retorna quantas */
+long juntar_estadias(const Indice *conjunto, AcaoEstadia acao, void *ctx) {
+    if (conjunto->quantidade == 0) return 0;
+    long n = filtrar_estadias(cliente_no_conjunto, conjunto, acao, ctx);
+    return n > 0 ? n : 0;
+}
+
+// acao da busca por nome: poe o cliente achado no conjunto da juncao
+void incluir_cliente_achado(const void *reg, long pos, void *ctx) {
+    const Cliente *c = reg;
+    Indice *conjunto = ctx;
+    if (indice_buscar(conjunto, c->codigo) < 0) indice_inserir(conjunto, c->codigo, pos);
+}
+
+void mostrar_estadia(const Estadia *e, void *ctx) {
+    (void)ctx;
+    char ent[9], sai[9];
+    formatar_data(e->dataEntrada, ent); formatar_data(e->dataSaida, sai);
+    printf("Estadia %d | Cliente %d | Quarto %d | %s -> %s | Diarias: %d | %s\n",
+           e->codigo, e->codCliente, e->numeroQuarto, ent, sai, e->qtdDiarias,
+           e->ativo ? "ativa" : "finalizada");
 }
 
 // listar todas as estadias de um cliente (por codigo ou pelo nome)
@@ -491,95 +4330,1698 @@ void listar_estadias_cliente() {
         printf("Codigo do cliente: "); scanf("%d", &cod);
         limpar_buffer_scanf(); // Limpeza de buffer
     } else {
-        printf("Nome (ou parte): ");
-        limpar_buffer_scanf(); // Limpeza de buffer
-        fgets(nomeBusca, sizeof(nomeBusca), stdin); trim_newline(nomeBusca);
+        printf("Nome (ou parte): ");
+        limpar_buffer_scanf(); // Limpeza de buffer
+        fgets(nomeBusca, sizeof(nomeBusca), stdin); trim_newline(nomeBusca);
+    }
+
+    if (!ha_estadias()) { printf("Nenhuma estadia registrada.\n"); return; }
+    Indice conjunto;
+    memset(&conjunto, 0, sizeof(conjunto));
+    if (op == 1) {
+        indice_inserir(&conjunto, cod, 0);
+    } else if (idx_clientes.registros == 0) {
+        printf("Nenhum cliente cadastrado.\n"); return;
+    } else {
+        texto_buscar(&txt_clientes, nomeBusca, incluir_cliente_achado, &conjunto);
+    }
+    long achou = juntar_estadias(&conjunto, mostrar_estadia, NULL);
+    if (!achou) printf("Nenhuma estadia encontrada para o cliente.\n");
+    indice_liberar(&conjunto);
+}
+
+// calcular pontos de fidelidade: 10 pontos por diaria em todas as estadias do cliente
+void calcular_pontos() {
+    printf("Digite o codigo do cliente: ");
+    int cod; scanf("%d", &cod);
+    limpar_buffer_scanf(); // Limpeza de buffer
+
+    if (!ha_estadias()) { printf("Nenhuma estadia registrada.\n"); return; }
+    if (indice_buscar(&idx_fidelidade, cod) < 0)
+        indice_ler_cauda(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade), NULL);
+    // um registro do agregado em vez de varrer estadias.dat
+    Fidelidade fd;
+    int totalDiarias = 0;
+    if (ler_registro(ARQ_FIDELIDADE, sizeof(Fidelidade), indice_buscar(&idx_fidelidade, cod), &fd))
+        totalDiarias = fd.totalDiarias;
+    int pontos = totalDiarias * PONTOS_POR_DIARIA;
+    printf("Cliente %d: %d diarias acumuladas -> %d pontos de fidelidade\n", cod, totalDiarias, pontos);
+}
+
+int comparar_fidelidade(const void *a, const void *b) {
+    const Fidelidade *x = a, *y = b;
+    if (x->totalDiarias != y->totalDiarias) return y->totalDiarias > x->totalDiarias ? 1 : -1;
+    return (x->codCliente > y->codCliente) - (x->codCliente < y->codCliente);
+}
+
+// ranking dos N clientes com mais diarias, direto do agregado
+void listar_mais_fieis() {
+    printf("Quantos clientes no ranking? ");
+    int n;
+    if (scanf("%d", &n) != 1 || n <= 0) { printf("Quantidade invalida.\n"); limpar_buffer_scanf(); return; }
+    limpar_buffer_scanf();
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_FIDELIDADE, sizeof(Fidelidade)) || v.quantidade == 0) {
+        printf("Nenhuma estadia registrada.\n"); fechar_visao(&v); return;
+    }
+    Fidelidade *copia = malloc(v.quantidade * sizeof(Fidelidade));
+    if (!copia) { fechar_visao(&v); return; }
+    memcpy(copia, v.registros, v.quantidade * sizeof(Fidelidade));
+    size_t qtd = v.quantidade;
+    fechar_visao(&v);
+    qsort(copia, qtd, sizeof(Fidelidade), comparar_fidelidade);
+    for (size_t i = 0; i < qtd && i < (size_t)n; ++i) {
+        printf("%lu. Cliente %d | %d estadias | %d diarias | %d pontos\n", (unsigned long)(i + 1),
+               copia[i].codCliente, copia[i].estadias, copia[i].totalDiarias,
+               copia[i].totalDiarias * PONTOS_POR_DIARIA);
+    }
+    free(copia);
+}
+
+//funcoes auxiliares de listagem (debug/ajuda)
+
+void listar_todos_clientes() {
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_CLIENTES, sizeof(Cliente))) { printf("Nenhum cliente cadastrado.\n"); return; }
+    const Cliente *cs = v.registros;
+    for (size_t i = 0; i < v.quantidade; ++i) {
+        mostrar_cliente(&cs[i]); printf("----\n");
+    }
+    fechar_visao(&v);
+}
+
+void listar_todos_quartos() {
+    VisaoArquivo v;
+    if (!abrir_visao(&v, ARQ_QUARTOS, sizeof(Quarto))) { printf("Nenhum quarto cadastrado.\n"); return; }
+    const Quarto *qs = v.registros;
+    for (size_t i = 0; i < v.quantidade; ++i) {
+        const Quarto *q = &qs[i];
+        printf("Quarto %d | Capacidade: %d | Valor: R$ %.2f | Status: %s\n",
+               q->numero, q->qtdHospedes, q->valorDiaria, q->ocupado ? "ocupado" : "desocupado");
+    }
+    fechar_visao(&v);
+}
+
+void listar_todas_estadias() {
+    if (percorrer_estadias(mostrar_estadia, NULL) == 0) printf("Nenhuma estadia cadastrada.\n");
+}
+
+//modo lote: comandos em texto, um por linha
+
+/* formato (campos separados por ';', linhas vazias e '#' sao ignoradas):
+     cliente;nome;endereco;telefone
+     funcionario;nome;telefone;cargo;salario
+     quarto;numero;hospedes;diaria
+     estadia;codCliente;hospedes;DD/MM/AAAA;DD/MM/AAAA
+     baixa;codEstadia
+   cada comando chama a mesma funcao que o menu usa. o diario so vai para o
+   disco a cada grupo_comandos comandos (LOTE_COMANDOS ou o grupo de --lote)
+   e no fim (ver gravacao em lote). */
+#define LOTE_MAX_CAMPOS 8
+
+/* executa um comando ja separado em campos. retorna NULL ou o erro.
+   se resposta != NULL, recebe uma linha com o que foi gravado (codigo etc) */
+const char *executar_comando(char **c, size_t n, char *resposta, size_t tam) {
+    if (strcmp(c[0], "cliente") == 0) {
+        if (n != 4) return "uso: cliente;nome;endereco;telefone";
+        Cliente cl;
+        memset(&cl, 0, sizeof(cl));
+        copiar_campo(cl.nome, sizeof(cl.nome), c[1]);
+        copiar_campo(cl.endereco, sizeof(cl.endereco), c[2]);
+        copiar_campo(cl.telefone, sizeof(cl.telefone), c[3]);
+        if (!registrar_cliente(&cl)) return "Erro ao gravar arquivo de clientes.";
+        if (resposta) snprintf(resposta, tam, "cliente;%d", cl.codigo);
+        return NULL;
+    }
+    if (strcmp(c[0], "funcionario") == 0) {
+        Funcionario f;
+        memset(&f, 0, sizeof(f));
+        if (n != 5 || !campo_real(c[4], &f.salario)) return "uso: funcionario;nome;telefone;cargo;salario";
+        copiar_campo(f.nome, sizeof(f.nome), c[1]);
+        copiar_campo(f.telefone, sizeof(f.telefone), c[2]);
+        copiar_campo(f.cargo, sizeof(f.cargo), c[3]);
+        if (!registrar_funcionario(&f)) return "Erro ao gravar arquivo de funcionarios.";
+        if (resposta) snprintf(resposta, tam, "funcionario;%d", f.codigo);
+        return NULL;
+    }
+    if (strcmp(c[0], "quarto") == 0) {
+        int numero, hospedes;
+        Quarto q;
+        memset(&q, 0, sizeof(q));
+        if (n != 4 || !campo_inteiro(c[1], &numero) || !campo_inteiro(c[2], &hospedes) ||
+            !campo_real(c[3], &q.valorDiaria)) return "uso: quarto;numero;hospedes;diaria";
+        q.numero = numero;
+        q.qtdHospedes = (int16_t)hospedes;
+        const char *erro = registrar_quarto(&q);
+        if (!erro && resposta) snprintf(resposta, tam, "quarto;%d", q.numero);
+        return erro;
+    }
+    if (strcmp(c[0], "estadia") == 0) {
+        int cod, qtd;
+        Estadia e;
+        memset(&e, 0, sizeof(e));
+        if (n != 5 || !campo_inteiro(c[1], &cod) || !campo_inteiro(c[2], &qtd))
+            return "uso: estadia;codCliente;hospedes;DD/MM/AAAA;DD/MM/AAAA";
+        if (!campo_data(c[3], &e.dataEntrada) || !campo_data(c[4], &e.dataSaida)) return "Data invalida.";
+        e.codCliente = cod;
+        const char *erro = registrar_estadia(&e, qtd);
+        if (!erro && resposta) snprintf(resposta, tam, "estadia;%d;%d;%d", e.codigo, e.numeroQuarto, e.qtdDiarias);
+        return erro;
+    }
+    if (strcmp(c[0], "baixa") == 0) {
+        int cod;
+        Estadia e;
+        Quarto q;
+        if (n != 2 || !campo_inteiro(c[1], &cod)) return "uso: baixa;codEstadia";
+        const char *erro = finalizar_estadia(cod, &e, &q);
+        char total[TAM_REAIS];
+        if (!erro && resposta) snprintf(resposta, tam, "baixa;%d;%s", cod, formatar_centavos(preco_estadia(&e, &q), total));
+        return erro;
+    }
+    return "comando desconhecido";
+}
+
+// roda os comandos de arquivo ("-" = entrada padrao). retorna 1 se todos deram certo
+int executar_lote(const char *arquivo) {
+    FILE *in = strcmp(arquivo, "-") == 0 ? stdin : fopen(arquivo, "r");
+    if (!in) { perror("Erro ao abrir arquivo de comandos"); return 0; }
+    modo_lote = 1;
+    double inicio = agora_segundos();
+    long linha_num = 0, executados = 0, erros = 0;
+    char linha[512];
+    while (fgets(linha, sizeof(linha), in)) {
+        linha_num++;
+        char *campos[LOTE_MAX_CAMPOS];
+        size_t n = separar_campos(linha, campos, LOTE_MAX_CAMPOS);
+        if (campos[0][0] == '\0' || campos[0][0] == '#') continue;
+        double t = agora_segundos();
+        const char *erro = executar_comando(campos, n, NULL, 0);
+        if (!erro) medir(MED_COMANDO, t);
+        executados++;
+        if (erro) { printf("linha %ld: %s\n", linha_num, erro); erros++; }
+        if (!lote_comando_feito(0))
+            printf("linha %ld: erro ao descarregar os arquivos.\n", linha_num);
+    }
+    if (in != stdin) fclose(in);
+    if (!lote_encerrar()) { printf("Erro ao descarregar os arquivos no fim do lote.\n"); erros++; }
+    double segundos = agora_segundos() - inicio;
+    printf("Lote: %ld comandos (%ld ok, %ld com erro) em %.3f s", executados, executados - erros, erros, segundos);
+    if (segundos > 0) printf(" -> %.0f comandos/s", executados / segundos);
+    printf("\n");
+    return erros == 0;
+}
+
+//importacao em massa de CSV (--importar)
+
+/* o arquivo inteiro vai para a memoria e e cortado em pedacos que terminam
+   em fim de linha, um por nucleo. cada fio converte as suas linhas em
+   registros (so texto -> struct, sem tocar em arquivo nem em estado global).
+   depois, em ordem e num fio so, cada registro e validado contra o que ja
+   esta em memoria (indice de clientes e quartos, agendas) e ganha codigo de
+   um bloco reservado so para as linhas que passaram. no fim tudo e gravado
+   com um unico fwrite, na mesma transacao que atualiza o agregado de
+   fidelidade (por cliente) e marca os quartos ocupados.
+     clientes: nome;endereco;telefone
+     estadias: codCliente;numeroQuarto;DD/MM/AAAA;DD/MM/AAAA[;ativa|finalizada] */
+#define IMPORTACAO_MAX_FIOS 16
+#define IMPORTACAO_PEDACO_MINIMO (64 * 1024)
+#define IMPORTACAO_MAX_ERROS 50
+
+// converte os campos de uma linha em registro. retorna NULL ou o erro
+typedef const char *(*AnalisarLinha)(char **campos, size_t n, void *reg);
+
+typedef struct {
+    char *ini, *fim;           // pedaco do texto (fim exclusivo)
+    size_t tam_registro;
+    AnalisarLinha analisar;
+    char *registros;           // so as linhas que deram certo
+    long *linhas;              // linha de cada registro, contada dentro do pedaco
+    size_t qtd, cap;
+    long total_linhas;
+    long erro_linha[IMPORTACAO_MAX_ERROS];
+    const char *erro_msg[IMPORTACAO_MAX_ERROS];
+    long qtd_erros;
+} PedacoImportacao;
+
+FIO_RETORNO analisar_pedaco(void *arg) {
+    PedacoImportacao *p = arg;
+    char *linha = p->ini;
+    while (linha < p->fim) {
+        char *nl = memchr(linha, '\n', (size_t)(p->fim - linha));
+        char *prox = nl ? nl + 1 : p->fim;
+        if (nl) *nl = '\0';
+        p->total_linhas++;
+        char *campos[LOTE_MAX_CAMPOS];
+        size_t n = separar_campos(linha, campos, LOTE_MAX_CAMPOS);
+        linha = prox;
+        if (campos[0][0] == '\0' || campos[0][0] == '#') continue;
+        if (p->qtd == p->cap) {
+            size_t nova_cap = p->cap ? p->cap * 2 : 1024;
+            char *regs = realloc(p->registros, nova_cap * p->tam_registro);
+            if (regs) p->registros = regs;
+            long *linhas = realloc(p->linhas, nova_cap * sizeof(long));
+            if (linhas) p->linhas = linhas;
+            if (!regs || !linhas) break;
+            p->cap = nova_cap;
+        }
+        char *reg = p->registros + p->qtd * p->tam_registro;
+        memset(reg, 0, p->tam_registro);
+        const char *erro = p->analisar(campos, n, reg);
+        if (erro) {
+            if (p->qtd_erros < IMPORTACAO_MAX_ERROS) {
+                p->erro_linha[p->qtd_erros] = p->total_linhas;
+                p->erro_msg[p->qtd_erros] = erro;
+            }
+            p->qtd_erros++;
+            continue;
+        }
+        p->linhas[p->qtd++] = p->total_linhas;
+    }
+    return 0;
+}
+
+const char *analisar_cliente_csv(char **c, size_t n, void *reg) {
+    Cliente *cl = reg;
+    if (n != 3 || c[0][0] == '\0') return "esperado nome;endereco;telefone";
+    copiar_campo(cl->nome, sizeof(cl->nome), c[0]);
+    copiar_campo(cl->endereco, sizeof(cl->endereco), c[1]);
+    copiar_campo(cl->telefone, sizeof(cl->telefone), c[2]);
+    return NULL;
+}
+
+const char *analisar_estadia_csv(char **c, size_t n, void *reg) {
+    Estadia *e = reg;
+    int cod, quarto;
+    if ((n != 4 && n != 5) || !campo_inteiro(c[0], &cod) || !campo_inteiro(c[1], &quarto))
+        return "esperado codCliente;numeroQuarto;entrada;saida[;ativa|finalizada]";
+    if (!campo_data(c[2], &e->dataEntrada) || !campo_data(c[3], &e->dataSaida)) return "Data invalida.";
+    int dias = diff_days(e->dataEntrada, e->dataSaida);
+    if (dias <= 0) return "Periodo invalido (saida deve ser apos entrada).";
+    e->codCliente = cod;
+    e->numeroQuarto = quarto;
+    e->qtdDiarias = (int16_t)dias;
+    e->ativo = 1;
+    if (n == 5 && strcmp(c[4], "finalizada") == 0) e->ativo = 0;
+    else if (n == 5 && strcmp(c[4], "ativa") != 0) return "status deve ser ativa ou finalizada";
+    return NULL;
+}
+
+// validacao em ordem: referencias e conflito de datas. retorna NULL ou o erro
+const char *validar_estadia_importada(Estadia *e) {
+    if (indice_buscar(&idx_clientes, e->codCliente) < 0) return "Cliente nao encontrado.";
+    if (indice_buscar(&idx_quartos, e->numeroQuarto) < 0) return "Quarto nao encontrado.";
+    // so estadias ativas entram na agenda, como no cadastro
+    if (e->ativo) {
+        if (!periodo_livre(e->numeroQuarto, e->dataEntrada, e->dataSaida)) return "Quarto ocupado no periodo.";
+        agenda_inserir(e);
+    }
+    return NULL;
+}
+
+/* na transacao aberta: o agregado soma as estadias importadas, por cliente,
+   e os quartos com estadia ativa nova ficam ocupados, como no cadastro.
+   fidelidade.dat fica inteiro travado; quem chama solta os registros depois
+   do commit (destravar_todos_registros) */
+int registrar_importadas(const Estadia *es, size_t n) {
+    if (!travar_anexo(ARQ_FIDELIDADE)) return 0;
+    int ok = travar_todos_registros(ARQ_FIDELIDADE);
+    CalculoFidelidade c;
+    memset(&c, 0, sizeof(c));
+    for (size_t k = 0; ok && k < n; ++k) {
+        Fidelidade *fd = fidelidade_do_cliente(&c, es[k].codCliente);
+        if (!fd) { ok = 0; break; }
+        fd->totalDiarias += es[k].qtdDiarias;
+        if (!es[k].ativo) fd->diariasFinalizadas += es[k].qtdDiarias;
+        fd->estadias++;
+    }
+    ok = ok && fidelidade_somar_deltas(c.tabela, c.qtd);
+    destravar_anexo(ARQ_FIDELIDADE); // so solta no commit
+    free(c.tabela);
+    indice_liberar(&c.por_cliente);
+    Indice marcados;
+    memset(&marcados, 0, sizeof(marcados));
+    for (size_t k = 0; ok && k < n; ++k) {
+        if (!es[k].ativo || indice_buscar(&marcados, es[k].numeroQuarto) >= 0) continue;
+        indice_inserir(&marcados, es[k].numeroQuarto, 0);
+        ok = atualizar_quarto(es[k].numeroQuarto, 1);
+    }
+    indice_liberar(&marcados);
+    return ok;
+}
+
+// le o arquivo inteiro com um '\0' no fim
+char *ler_arquivo_texto(const char *arquivo, size_t *tam) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return NULL;
+    char *texto = NULL;
+    long n = -1;
+    if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0 &&
+        (texto = malloc((size_t)n + 1)) != NULL && fread(texto, 1, (size_t)n, f) == (size_t)n) {
+        texto[n] = '\0';
+        *tam = (size_t)n;
+    } else {
+        free(texto);
+        texto = NULL;
+    }
+    fclose(f);
+    return texto;
+}
+
+// tipo: "clientes" ou "estadias". retorna 1 se todas as linhas foram gravadas
+int importar_csv(const char *tipo, const char *arquivo) {
+    int clientes = strcmp(tipo, "clientes") == 0;
+    if (!clientes && strcmp(tipo, "estadias") != 0) { printf("Tipo de importacao invalido: %s\n", tipo); return 0; }
+    size_t tam_registro = clientes ? sizeof(Cliente) : sizeof(Estadia);
+    size_t tam;
+    char *texto = ler_arquivo_texto(arquivo, &tam);
+    if (!texto) { perror("Erro ao ler arquivo de importacao"); return 0; }
+
+    // analise em paralelo
+    double t0 = agora_segundos();
+    int fios = numero_de_nucleos();
+    if (fios > IMPORTACAO_MAX_FIOS) fios = IMPORTACAO_MAX_FIOS;
+    if ((size_t)fios > tam / IMPORTACAO_PEDACO_MINIMO) fios = (int)(tam / IMPORTACAO_PEDACO_MINIMO);
+    if (fios < 1) fios = 1;
+    PedacoImportacao *pedacos = calloc((size_t)fios, sizeof(PedacoImportacao));
+    if (!pedacos) { printf("Memoria insuficiente para importar.\n"); free(texto); return 0; }
+    Fio ids[IMPORTACAO_MAX_FIOS];
+    char *ini = texto;
+    for (int i = 0; i < fios; ++i) {
+        char *fim = i == fios - 1 ? texto + tam : texto + tam * (size_t)(i + 1) / (size_t)fios;
+        // cada corte avanca ate depois do proximo fim de linha
+        while (fim < texto + tam && fim > ini && fim[-1] != '\n') fim++;
+        pedacos[i].ini = ini;
+        pedacos[i].fim = fim;
+        pedacos[i].tam_registro = tam_registro;
+        pedacos[i].analisar = clientes ? analisar_cliente_csv : analisar_estadia_csv;
+        ini = fim;
+    }
+    int iniciados = 0;
+    for (; iniciados < fios; ++iniciados) {
+        if (!iniciar_fio(&ids[iniciados], analisar_pedaco, &pedacos[iniciados])) break;
     }
+    // se nao deu para criar algum fio, o resto e analisado aqui mesmo
+    for (int i = iniciados; i < fios; ++i) analisar_pedaco(&pedacos[i]);
+    for (int i = 0; i < iniciados; ++i) esperar_fio(ids[i]);
+    double t1 = agora_segundos();
+
+    /* validacao em ordem; codigo so para as linhas que passaram. o fim do
+       arquivo fica travado ate o commit: o que outros terminais gravaram
+       entra antes da validacao e ninguem anexa (nem reserva quarto) no meio */
+    size_t total = 0;
+    long erros = 0;
+    for (int i = 0; i < fios; ++i) total += pedacos[i].qtd;
+    char *saida = malloc((total ? total : 1) * tam_registro);
+    Indice *idx = clientes ? &idx_clientes : &idx_estadias;
+    const char *arq = clientes ? ARQ_CLIENTES : ARQ_ESTADIAS;
+    int travado = travar_anexo(arq);
+    if (!travado) printf("Erro ao travar %s.\n", arq);
+    sincronizar_clientes();
+    if (!clientes) {
+        sincronizar_quartos();
+        sincronizar_estadias();
+    }
+    size_t gravar = 0;
+    long linha_base = 0;
+    for (int i = 0; saida && travado && i < fios; ++i) {
+        PedacoImportacao *p = &pedacos[i];
+        for (long k = 0; k < p->qtd_erros && k < IMPORTACAO_MAX_ERROS; ++k)
+            printf("linha %ld: %s\n", linha_base + p->erro_linha[k], p->erro_msg[k]);
+        erros += p->qtd_erros;
+        for (size_t k = 0; k < p->qtd; ++k) {
+            char *reg = p->registros + k * tam_registro;
+            int32_t cod = 0;
+            memcpy(reg, &cod, sizeof(cod)); // codigo e o primeiro campo das duas structs
+            const char *erro = clientes ? NULL : validar_estadia_importada((Estadia *)reg);
+            if (erro) { printf("linha %ld: %s\n", linha_base + p->linhas[k], erro); erros++; continue; }
+            memcpy(saida + gravar++ * tam_registro, reg, tam_registro);
+        }
+        linha_base += p->total_linhas;
+    }
+    double t2 = agora_segundos();
+
+    // codigos, registros, agregado e quartos numa transacao so
+    int ok = saida != NULL && travado;
+    if (ok && gravar > 0) {
+        transacao_iniciar();
+        int codigo = reservar_codigos(idx, arq, tam_registro, (int)gravar);
+        ok = codigo >= 0;
+        for (size_t k = 0; ok && k < gravar; ++k) {
+            int32_t cod = codigo + (int32_t)k;
+            memcpy(saida + k * tam_registro, &cod, sizeof(cod));
+            if (!clientes && ((Estadia *)saida)[k].ativo) agenda_definir_codigo(&((Estadia *)saida)[k]);
+        }
+        ok = ok && anexar_publicando(clientes ? ALT_CLIENTE : ALT_ESTADIA, idx, arq, saida, gravar, tam_registro);
+        if (ok && !clientes) ok = registrar_importadas((Estadia *)saida, gravar);
+        if (!ok) transacao_descartar();
+        else ok = transacao_confirmar();
+        if (!clientes) destravar_todos_registros(ARQ_FIDELIDADE);
+        if (!ok && clientes) indice_carregar(idx, arq, tam_registro);
+        if (!ok && !clientes) {
+            // indice, agendas e agregado ja tinham as estadias
+            recarregar_estadias();
+            indice_carregar(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade));
+        }
+    }
+    if (travado) destravar_anexo(arq);
+    if (ok && clientes) {
+        long primeiro = idx->registros - (long)gravar;
+        for (size_t k = 0; k < gravar; ++k)
+            texto_indexar(&txt_clientes, ((Cliente *)saida)[k].nome, primeiro + (long)k);
+    }
+    double t3 = agora_segundos();
+    if (!ok) printf("Erro ao gravar %s.\n", arq);
+    printf("Importacao: %ld linhas, %lu gravadas, %ld com erro em %.3f s "
+           "(analise %.3f s com %d fios, validacao %.3f s, gravacao %.3f s)\n",
+           linha_base, (unsigned long)(ok ? gravar : 0), erros, t3 - t0, t1 - t0, fios, t2 - t1, t3 - t2);
+
+    for (int i = 0; i < fios; ++i) { free(pedacos[i].registros); free(pedacos[i].linhas); }
+    free(pedacos);
+    free(saida);
+    free(texto);
+    return ok && erros == 0;
+}
+
+//replicacao: log de alteracoes (--publicar, --seguir)
+
+/* --publicar cria alteracoes.log na pasta com os dados atuais, uma
+   insercao por registro (estadias arquivadas inclusive); dali em diante
+   cada commit acrescenta as suas alteracoes (ver o diario). --seguir
+   ORIGEM, rodado na pasta da replica, le o log de ORIGEM de onde parou e
+   aplica as alteracoes pelas mesmas funcoes de gravacao, SEGUIR_LOTE por
+   transacao do diario da replica junto com a posicao em seguidor.pos:
+   depois de uma queda nada e aplicado duas vezes nem pulado. insercao de
+   chave que a replica ja tem vira atualizacao. o agregado de fidelidade da
+   replica acompanha as estadias aplicadas. a replica e so para consultas
+   e relatorios: cadastros, baixas e compactacao sao feitos na origem. */
+#define SEGUIR_LOTE 64
+#define SEGUIR_ESPERA_MS 1000
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char magia[4];      // "SEG1"
+    uint32_t origem;    // CabecalhoAlteracoes.origem do log seguido
+    uint32_t sequencia; // ultima alteracao aplicada
+    uint32_t lido;      // bytes do log ja aplicados
+} PosicaoSeguidor;
 
-    FILE *fe = fopen(ARQ_ESTADIAS, "rb");
-    if (!fe) { printf("Nenhuma estadia registrada.\n"); return; }
-    FILE *fc = fopen(ARQ_CLIENTES, "rb");
-    if (!fc) { printf("Nenhum cliente cadastrado.\n"); fclose(fe); return; }
+#pragma pack(pop)
 
-    Estadia e; int achou = 0;
-    while (fread(&e, sizeof(Estadia), 1, fe) == 1) {
-        int mostrar = 0;
-        if (op == 1) {
-            if (e.codCliente == cod) mostrar = 1;
+typedef struct {
+    FILE *f;
+    CabecalhoAlteracoes cab;
+    int ok;
+} Publicacao;
+
+void publicar_registro(Publicacao *p, TipoAlteracao tipo, const void *reg, size_t tam) {
+    Alteracao a;
+    memset(&a, 0, sizeof(a));
+    a.sequencia = p->cab.proxima++;
+    a.tipo = (uint8_t)tipo;
+    a.operacao = ALT_INSERCAO;
+    a.tam = (uint16_t)tam;
+    a.soma = soma_verificacao(reg, tam, soma_verificacao(&a, offsetof(Alteracao, soma), 2166136261u));
+    if (fwrite(&a, sizeof(a), 1, p->f) != 1 || fwrite(reg, tam, 1, p->f) != 1) p->ok = 0;
+    p->cab.fim += (uint32_t)(sizeof(a) + tam);
+}
+
+void publicar_estadia(const Estadia *e, void *ctx) {
+    publicar_registro(ctx, ALT_ESTADIA, e, sizeof(Estadia));
+}
+
+// uma insercao para cada registro do .dat (que pode nao existir)
+void publicar_arquivo(Publicacao *p, TipoAlteracao tipo, const char *arquivo, size_t tam_registro) {
+    CabecalhoArquivo cab;
+    FILE *f = abrir_dados(arquivo, tam_registro, &cab);
+    if (!f) return;
+    char reg[sizeof(Cliente)]; // o maior registro
+    for (uint32_t i = 0; i < cab.quantidade && fread(reg, tam_registro, 1, f) == 1; ++i)
+        publicar_registro(p, tipo, reg, tam_registro);
+    fclose(f);
+}
+
+/* grava o log ao lado, renomeia e marca no cabecalho do diario que a pasta
+   e publicada. com o fim de estadias.dat travado (nem reserva nem
+   compactacao) e o diario travado (nenhum commit) os dados ficam parados
+   enquanto sao lidos */
+int publicar_pasta() {
+    if (!travar_anexo(ARQ_ESTADIAS)) { printf("Erro ao travar arquivo de estadias.\n"); return 0; }
+    if (!trava_byte(ARQ_DIARIO, 0, TRAVA_ESPERAR)) { destravar_anexo(ARQ_ESTADIAS); return 0; }
+    CabecalhoDiario cd;
+    FILE *j = diario_abrir(&cd);
+    long fim = j ? diario_reaplicar(j, cd.aplicado) : -1;
+    int ok = fim >= 0;
+    fechar_aplicados();
+    FILE *log = fopen(ARQ_ALTERACOES, "rb");
+    int existia = log != NULL;
+    if (log) fclose(log);
+    Publicacao p;
+    memset(&p, 0, sizeof(p));
+    if (existia) {
+        printf("%s ja existe: as alteracoes ja sao publicadas.\n", ARQ_ALTERACOES);
+    } else if (ok) {
+        const char *novo = ARQ_ALTERACOES ".novo";
+        memcpy(p.cab.magia, "ALT1", 4);
+        p.cab.proxima = 1;
+        p.cab.fim = sizeof(p.cab);
+        p.cab.origem = (uint32_t)time(NULL);
+        p.ok = 1;
+        if ((p.f = fopen(novo, "wb")) != NULL && fwrite(&p.cab, sizeof(p.cab), 1, p.f) == 1) {
+            publicar_arquivo(&p, ALT_QUARTO, ARQ_QUARTOS, sizeof(Quarto));
+            publicar_arquivo(&p, ALT_CLIENTE, ARQ_CLIENTES, sizeof(Cliente));
+            publicar_arquivo(&p, ALT_FUNCIONARIO, ARQ_FUNCIONARIOS, sizeof(Funcionario));
+            percorrer_estadias(publicar_estadia, &p);
+            ok = p.ok && fseek(p.f, 0, SEEK_SET) == 0 && fwrite(&p.cab, sizeof(p.cab), 1, p.f) == 1 &&
+                 descarregar_arquivo(p.f);
         } else {
-            //achar nome do cliente (busca simples case-sensitive)
-            rewind(fc);
-            Cliente ctmp;
-            while (fread(&ctmp, sizeof(Cliente), 1, fc) == 1) {
-                if (ctmp.codigo == e.codCliente) {
-                    if (strstr(ctmp.nome, nomeBusca) != NULL) mostrar = 1;
-                    break;
-                }
+            ok = 0;
+        }
+        if (p.f && fclose(p.f) != 0) ok = 0;
+        ok = ok && substituir_arquivo(novo, ARQ_ALTERACOES);
+        if (!ok) remove(novo);
+    }
+    if (ok) {
+        cd.publicado = 1;
+        ok = diario_marcar_aplicado(j, &cd, fim) && descarregar_arquivo(j);
+    }
+    if (j) diario_fechar(j);
+    trava_byte(ARQ_DIARIO, 0, TRAVA_SOLTAR);
+    destravar_anexo(ARQ_ESTADIAS);
+    if (!ok) { printf("Erro ao gravar %s.\n", ARQ_ALTERACOES); return 0; }
+    if (!existia) printf("%s criado com %u registros; as proximas alteracoes entram nele.\n", ARQ_ALTERACOES, p.cab.proxima - 1);
+    return 1;
+}
+
+// arquivo, indice e tamanho do registro de cada tipo. retorna 0 se o tipo nao existe
+int destino_alteracao(int tipo, const char **arquivo, Indice **idx, size_t *tam) {
+    switch (tipo) {
+        case ALT_CLIENTE: *arquivo = ARQ_CLIENTES; *idx = &idx_clientes; *tam = sizeof(Cliente); return 1;
+        case ALT_FUNCIONARIO: *arquivo = ARQ_FUNCIONARIOS; *idx = &idx_funcionarios; *tam = sizeof(Funcionario); return 1;
+        case ALT_QUARTO: *arquivo = ARQ_QUARTOS; *idx = &idx_quartos; *tam = sizeof(Quarto); return 1;
+        case ALT_ESTADIA: *arquivo = ARQ_ESTADIAS; *idx = &idx_estadias; *tam = sizeof(Estadia); return 1;
+    }
+    return 0;
+}
+
+/* estadia na replica: o agregado tira o que a versao velha somava (se havia)
+   e soma a nova; a regravacao conta como baixa para os outros terminais */
+int aplicar_estadia(const Estadia *nova) {
+    long pos = indice_buscar(&idx_estadias, nova->codigo);
+    if (pos < 0)
+        return anexar_publicando(ALT_ESTADIA, &idx_estadias, ARQ_ESTADIAS, nova, 1, sizeof(Estadia)) &&
+               fidelidade_somar(nova->codCliente, nova->qtdDiarias, nova->ativo ? 0 : nova->qtdDiarias, 1);
+    Estadia velha;
+    if (!ler_registro(ARQ_ESTADIAS, sizeof(Estadia), pos, &velha) ||
+        !gravar_publicando(ALT_ESTADIA, ARQ_ESTADIAS, nova, sizeof(Estadia), pos)) return 0;
+    if (!travar_anexo(ARQ_ESTADIAS)) return 0;
+    int ok = registrar_alteracao_estadias();
+    destravar_anexo(ARQ_ESTADIAS);
+    int fin_velha = velha.ativo ? 0 : velha.qtdDiarias, fin_nova = nova->ativo ? 0 : nova->qtdDiarias;
+    if (ok && velha.codCliente != nova->codCliente)
+        ok = fidelidade_somar(velha.codCliente, -velha.qtdDiarias, -fin_velha, -1) &&
+             fidelidade_somar(nova->codCliente, nova->qtdDiarias, fin_nova, 1);
+    else if (ok && (velha.qtdDiarias != nova->qtdDiarias || fin_velha != fin_nova))
+        ok = fidelidade_somar(nova->codCliente, nova->qtdDiarias - velha.qtdDiarias, fin_nova - fin_velha, 0);
+    return ok;
+}
+
+// aplica uma alteracao do log na replica, na transacao aberta
+int aplicar_alteracao(const Alteracao *a, const char *reg) {
+    const char *arquivo;
+    Indice *idx;
+    size_t tam;
+    if (!destino_alteracao(a->tipo, &arquivo, &idx, &tam) || a->tam != tam) return 0;
+    if (a->tipo == ALT_ESTADIA) {
+        Estadia e;
+        memcpy(&e, reg, sizeof(e));
+        return aplicar_estadia(&e);
+    }
+    int32_t chave;
+    memcpy(&chave, reg, sizeof(chave));
+    long pos = indice_buscar(idx, chave);
+    if (pos < 0) return anexar_publicando((TipoAlteracao)a->tipo, idx, arquivo, reg, 1, tam);
+    return gravar_publicando((TipoAlteracao)a->tipo, arquivo, reg, tam, pos);
+}
+
+// posicao da replica; replica nova comeca no inicio do log
+void ler_posicao(PosicaoSeguidor *pos, const CabecalhoAlteracoes *cab) {
+    FILE *f = fopen(ARQ_SEGUIDOR, "rb");
+    int ok = f != NULL && fread(pos, sizeof(*pos), 1, f) == 1 && memcmp(pos->magia, "SEG1", 4) == 0;
+    if (f) fclose(f);
+    if (ok) return;
+    memcpy(pos->magia, "SEG1", 4);
+    pos->origem = cab->origem;
+    pos->sequencia = 0;
+    pos->lido = sizeof(*cab);
+}
+
+/* aplica o que o log tem depois da posicao da replica. retorna quantas
+   alteracoes aplicou ou -1 se o log nao pode ser seguido */
+long seguir_rodada(const char *log) {
+    FILE *f = fopen(log, "rb");
+    if (!f) { printf("Log de alteracoes nao encontrado: %s (rode --publicar na origem).\n", log); return -1; }
+    CabecalhoAlteracoes cab;
+    PosicaoSeguidor pos;
+    if (fread(&cab, sizeof(cab), 1, f) != 1 || memcmp(cab.magia, "ALT1", 4) != 0) {
+        printf("Log de alteracoes invalido: %s\n", log);
+        fclose(f);
+        return -1;
+    }
+    ler_posicao(&pos, &cab);
+    if (pos.origem != cab.origem) {
+        printf("Esta replica segue outro log (publicado de novo?): comece de uma pasta vazia.\n");
+        fclose(f);
+        return -1;
+    }
+    long aplicadas = 0, no_lote = 0;
+    const char *erro = NULL;
+    char reg[sizeof(Cliente)];
+    if (pos.lido < cab.fim && fseek(f, (long)pos.lido, SEEK_SET) != 0) erro = "Erro ao ler o log de alteracoes.";
+    transacao_iniciar();
+    while (!erro && pos.lido < cab.fim) {
+        Alteracao a;
+        if (fread(&a, sizeof(a), 1, f) != 1 || a.tam > sizeof(reg) ||
+            sizeof(a) + a.tam > cab.fim - pos.lido || fread(reg, a.tam, 1, f) != 1 ||
+            a.soma != soma_verificacao(reg, a.tam, soma_verificacao(&a, offsetof(Alteracao, soma), 2166136261u)) ||
+            a.sequencia != pos.sequencia + 1) {
+            erro = "Log de alteracoes corrompido.";
+            break;
+        }
+        if (!aplicar_alteracao(&a, reg)) { erro = "Erro ao aplicar alteracao na replica."; break; }
+        pos.sequencia = a.sequencia;
+        pos.lido += (uint32_t)(sizeof(a) + a.tam);
+        aplicadas++;
+        if (++no_lote == SEGUIR_LOTE || pos.lido == cab.fim) {
+            if (!transacao_gravar(ARQ_SEGUIDOR, 0, &pos, sizeof(pos)) || !transacao_confirmar()) {
+                erro = "Erro ao gravar o diario.";
+                transacao_iniciar(); // descartada abaixo, sem nada dentro
+                break;
             }
+            no_lote = 0;
+            transacao_iniciar();
         }
-        if (mostrar) {
-            printf("Estadia %d | Cliente %d | Quarto %d | %s -> %s | Diarias: %d | %s\n",
-                   e.codigo, e.codCliente, e.numeroQuarto, e.dataEntrada, e.dataSaida, e.qtdDiarias,
-                   e.ativo ? "ativa" : "finalizada");
-            achou = 1;
+    }
+    fclose(f);
+    if (erro) {
+        transacao_descartar();
+        // os indices podem ter o que nao foi gravado
+        carregar_indices();
+        indice_carregar(&idx_fidelidade, ARQ_FIDELIDADE, sizeof(Fidelidade));
+        printf("%s (alteracao %u)\n", erro, pos.sequencia + 1);
+        return -1;
+    }
+    transacao_confirmar(); // vazia
+    if (aplicadas > 0) printf("%ld alteracoes aplicadas (ate a %u).\n", aplicadas, pos.sequencia);
+    return aplicadas;
+}
+
+void esperar_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec pausa = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&pausa, NULL);
+#endif
+}
+
+/* --seguir ORIGEM [espera_ms]: uma rodada a cada espera_ms (0: so uma).
+   as rodadas sao gravadas como um lote: um fsync do diario por rodada */
+int seguir_origem(const char *origem, int espera_ms) {
+    char log[512];
+    snprintf(log, sizeof(log), "%s/%s", origem, ARQ_ALTERACOES);
+    modo_lote = 1;
+    int ok = 1;
+    for (;;) {
+        ok = seguir_rodada(log) >= 0;
+        if (!lote_descarregar()) { printf("Erro ao descarregar os arquivos.\n"); ok = 0; }
+        fflush(stdout);
+        if (!ok || espera_ms <= 0) break;
+        esperar_ms(espera_ms);
+    }
+    if (!lote_encerrar()) ok = 0;
+    return ok;
+}
+
+//relatorio de ocupacao e receita
+
+/* retrato das estadias em colunas: um vetor por campo, todos do mesmo
+   tamanho, montado com uma leitura das estadias (arquivadas e estadias.dat)
+   e outra de quartos.dat.
+   as somas por periodo so leem os vetores que usam, em sequencia e sem
+   desvio por registro (o corte no periodo e feito com min/max), o que o
+   compilador consegue vetorizar. a receita de cada estadia e a diferenca
+   de dois prefixos da tabela de tarifas do ano. estadias ativas e
+   finalizadas contam */
+typedef struct {
+    size_t qtd;
+    int32_t *quarto;    // posicao do quarto em numeros[]; qtd_quartos = quarto sumido
+    Data *entrada;
+    int32_t *noites;
+    int32_t *cliente;
+    size_t qtd_quartos;
+    int32_t *numeros;   // numero de cada quarto
+} RetratoEstadias;
+
+void retrato_liberar(RetratoEstadias *r) {
+    free(r->quarto); free(r->entrada); free(r->noites); free(r->cliente);
+    free(r->numeros);
+    memset(r, 0, sizeof(*r));
+}
+
+typedef struct {
+    RetratoEstadias *r;
+    Indice slot;    // numero do quarto -> posicao em numeros[]
+    size_t cap;
+    int ok;
+} MontagemRetrato;
+
+// uma estadia no fim dos vetores, que dobram quando enchem
+void retrato_incluir(const Estadia *e, void *ctx) {
+    MontagemRetrato *m = ctx;
+    RetratoEstadias *r = m->r;
+    if (!m->ok) return;
+    if (r->qtd == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 1024;
+        int32_t *quarto = realloc(r->quarto, cap * sizeof(int32_t));
+        if (quarto) r->quarto = quarto;
+        Data *entrada = realloc(r->entrada, cap * sizeof(Data));
+        if (entrada) r->entrada = entrada;
+        int32_t *noites = realloc(r->noites, cap * sizeof(int32_t));
+        if (noites) r->noites = noites;
+        int32_t *cliente = realloc(r->cliente, cap * sizeof(int32_t));
+        if (cliente) r->cliente = cliente;
+        if (!quarto || !entrada || !noites || !cliente) { m->ok = 0; return; }
+        m->cap = cap;
+    }
+    long s = indice_buscar(&m->slot, e->numeroQuarto);
+    int32_t q = s >= 0 ? (int32_t)s : (int32_t)r->qtd_quartos;
+    size_t i = r->qtd++;
+    r->quarto[i] = q;
+    r->entrada[i] = e->dataEntrada;
+    r->noites[i] = e->qtdDiarias;
+    r->cliente[i] = e->codCliente;
+}
+
+// retorna 0 se faltou memoria
+int retrato_montar(RetratoEstadias *r) {
+    memset(r, 0, sizeof(*r));
+    MontagemRetrato m;
+    memset(&m, 0, sizeof(m));
+    m.r = r;
+    VisaoArquivo vq;
+    int tem_quartos = abrir_visao(&vq, ARQ_QUARTOS, sizeof(Quarto));
+    size_t nq = tem_quartos ? vq.quantidade : 0;
+
+    // so o primeiro registro de cada numero vale (como no indice)
+    const Quarto *qs = tem_quartos ? vq.registros : NULL;
+    r->numeros = malloc((nq + 1) * sizeof(int32_t));
+    m.ok = r->numeros != NULL;
+    for (size_t i = 0; m.ok && i < nq; ++i) {
+        if (indice_buscar(&m.slot, qs[i].numero) >= 0) continue;
+        indice_inserir(&m.slot, qs[i].numero, (long)r->qtd_quartos);
+        r->numeros[r->qtd_quartos++] = qs[i].numero;
+    }
+    if (tem_quartos) fechar_visao(&vq);
+    if (m.ok) percorrer_estadias(retrato_incluir, &m);
+    indice_liberar(&m.slot);
+    if (!m.ok) retrato_liberar(r);
+    return m.ok;
+}
+
+typedef struct {
+    double noites;
+    Centavos receita;
+} SomaPeriodo;
+
+/* tabela de tarifas do ano em t_out e onde comeca nela a linha de cada
+   quarto do retrato, ja descontado o primeiro dia do ano:
+   prefixo[desloc[q] + dia] e a soma das noites do quarto antes do dia.
+   quarto sumido aponta para a linha zerada. retorna o vetor (free) ou NULL
+   se faltou memoria */
+long *deslocamentos_tarifa(const RetratoEstadias *r, int ano, const TabelaAno **t_out) {
+    long *desloc = malloc((r->qtd_quartos + 1) * sizeof(long));
+    if (!desloc) return NULL;
+    // as linhas antes da tabela: quarto novo rele as diarias e descarta as tabelas
+    for (size_t q = 0; q <= r->qtd_quartos; ++q) desloc[q] = q < r->qtd_quartos ? tarifa_linha(r->numeros[q]) : -1;
+    tarifas_atualizar();
+    const TabelaAno *t = tabela_do_ano(ano);
+    if (!t) { free(desloc); return NULL; }
+    long largura = t->dias + 1;
+    for (size_t q = 0; q <= r->qtd_quartos; ++q)
+        desloc[q] = (desloc[q] >= 0 ? desloc[q] : (long)tarifario.qtd_linhas) * largura - t->inicio;
+    *t_out = t;
+    return desloc;
+}
+
+/* diarias vendidas e receita dentro de [inicio, fim). com t (tabela do ano
+   que contem o periodo) e desloc a receita sai dos prefixos; sem, so as
+   diarias */
+SomaPeriodo somar_periodo(const RetratoEstadias *r, const TabelaAno *t, const long *desloc, Data inicio, Data fim) {
+    double noites = 0;
+    Centavos receita = 0;
+    const Data *ent = r->entrada;
+    const int32_t *nts = r->noites;
+    for (size_t i = 0; i < r->qtd; ++i) {
+        Data a = ent[i] > inicio ? ent[i] : inicio;
+        Data b = ent[i] + nts[i] < fim ? ent[i] + nts[i] : fim;
+        noites += b > a ? (double)(b - a) : 0.0;
+    }
+    if (t) {
+        const int32_t *qt = r->quarto;
+        for (size_t i = 0; i < r->qtd; ++i) {
+            Data a = ent[i] > inicio ? ent[i] : inicio;
+            a = a < fim ? a : fim;
+            Data b = ent[i] + nts[i] < fim ? ent[i] + nts[i] : fim;
+            b = b > a ? b : a;
+            receita += t->prefixo[desloc[qt[i]] + b] - t->prefixo[desloc[qt[i]] + a];
         }
     }
-    if (!achou) printf("Nenhuma estadia encontrada para o cliente.\n");
-    fclose(fe); fclose(fc);
+    SomaPeriodo soma = { noites, receita };
+    return soma;
 }
 
-// calcular pontos de fidelidade: 10 pontos por diaria em todas as estadias do cliente
-void calcular_pontos() {
-    printf("Digite o codigo do cliente: ");
-    int cod; scanf("%d", &cod);
-    limpar_buffer_scanf(); // Limpeza de buffer
+// mesma soma, separada por quarto (noites e receita com qtd_quartos + 1 posicoes)
+void somar_por_quarto(const RetratoEstadias *r, const TabelaAno *t, const long *desloc, Data inicio, Data fim,
+                      double *noites, Centavos *receita) {
+    memset(noites, 0, (r->qtd_quartos + 1) * sizeof(double));
+    memset(receita, 0, (r->qtd_quartos + 1) * sizeof(Centavos));
+    for (size_t i = 0; i < r->qtd; ++i) {
+        Data a = r->entrada[i] > inicio ? r->entrada[i] : inicio;
+        a = a < fim ? a : fim;
+        Data b = r->entrada[i] + r->noites[i] < fim ? r->entrada[i] + r->noites[i] : fim;
+        b = b > a ? b : a;
+        noites[r->quarto[i]] += (double)(b - a);
+        receita[r->quarto[i]] += t->prefixo[desloc[r->quarto[i]] + b] - t->prefixo[desloc[r->quarto[i]] + a];
+    }
+}
+
+void mostrar_periodo(const char *rotulo, SomaPeriodo soma, double disponiveis) {
+    double ocupacao = disponiveis > 0 ? 100.0 * soma.noites / disponiveis : 0;
+    double revpar = disponiveis > 0 ? (double)soma.receita / 100 / disponiveis : 0;
+    char receita[TAM_REAIS];
+    printf("%-4s %8.1f%% %9.0f  R$ %12s  R$ %8.2f\n", rotulo, ocupacao, soma.noites,
+           formatar_centavos(soma.receita, receita), revpar);
+}
+
+/* ocupacao (diarias vendidas / diarias disponiveis), receita e RevPAR
+   (receita / diarias disponiveis) por mes do ano, e o ano por quarto */
+int relatorio_ocupacao(int ano) {
+    double inicio = agora_segundos();
+    RetratoEstadias r;
+    if (!retrato_montar(&r)) { printf("Sem memoria para o relatorio.\n"); return 0; }
+    double montado = agora_segundos();
+    if (r.qtd_quartos == 0) { printf("Nenhum quarto cadastrado.\n"); retrato_liberar(&r); return 0; }
 
-    FILE *fe = fopen(ARQ_ESTADIAS, "rb");
-    if (!fe) { printf("Nenhuma estadia registrada.\n"); return; }
-    Estadia e; int totalDiarias = 0;
-    // CORRIGIDO: Agora usa 'fe'
-    while (fread(&e, sizeof(Estadia), 1, fe) == 1) {
-        if (e.codCliente == cod) totalDiarias += e.qtdDiarias;
+    const TabelaAno *t = NULL;
+    long *desloc = deslocamentos_tarifa(&r, ano, &t);
+    double *noites = malloc((r.qtd_quartos + 1) * sizeof(double));
+    Centavos *receita = malloc((r.qtd_quartos + 1) * sizeof(Centavos));
+    if (!desloc || !noites || !receita) {
+        printf("Sem memoria para o relatorio.\n");
+        free(desloc); free(noites); free(receita); retrato_liberar(&r); return 0;
     }
-    fclose(fe);
-    int pontos = totalDiarias * 10;
-    printf("Cliente %d: %d diarias acumuladas -> %d pontos de fidelidade\n", cod, totalDiarias, pontos);
+    SomaPeriodo meses[12];
+    for (int m = 1; m <= 12; ++m)
+        meses[m - 1] = somar_periodo(&r, t, desloc, data_de_civil(ano, m, 1), m < 12 ? data_de_civil(ano, m + 1, 1) : data_de_civil(ano + 1, 1, 1));
+    Data ano_ini = data_de_civil(ano, 1, 1), ano_fim = data_de_civil(ano + 1, 1, 1);
+    SomaPeriodo total = somar_periodo(&r, t, desloc, ano_ini, ano_fim);
+    somar_por_quarto(&r, t, desloc, ano_ini, ano_fim, noites, receita);
+    double calculado = agora_segundos();
+
+    printf("Ocupacao e receita em %d (%lu quartos, %lu estadias)\n", ano,
+           (unsigned long)r.qtd_quartos, (unsigned long)r.qtd);
+    printf("Mes  Ocupacao   Diarias          Receita       RevPAR\n");
+    for (int m = 1; m <= 12; ++m) {
+        char rotulo[4];
+        snprintf(rotulo, sizeof(rotulo), "%02d", m);
+        Data mes_fim = m < 12 ? data_de_civil(ano, m + 1, 1) : ano_fim;
+        mostrar_periodo(rotulo, meses[m - 1], (double)r.qtd_quartos * (mes_fim - data_de_civil(ano, m, 1)));
+    }
+    double dias_ano = ano_fim - ano_ini;
+    mostrar_periodo("Ano", total, (double)r.qtd_quartos * dias_ano);
+    printf("Por quarto no ano:\n");
+    char valor[TAM_REAIS];
+    for (size_t q = 0; q < r.qtd_quartos; ++q) {
+        printf("Quarto %d | %.0f diarias | %.1f%% | R$ %s\n", r.numeros[q], noites[q],
+               100.0 * noites[q] / dias_ano, formatar_centavos(receita[q], valor));
+    }
+    if (noites[r.qtd_quartos] > 0)
+        printf("Estadias de quartos que nao existem mais: %.0f diarias\n", noites[r.qtd_quartos]);
+    printf("Retrato em %.1f ms, calculo em %.1f ms\n", (montado - inicio) * 1000, (calculado - montado) * 1000);
+    free(desloc);
+    free(noites);
+    free(receita);
+    retrato_liberar(&r);
+    return 1;
 }
 
-//funcoes auxiliares de listagem (debug/ajuda)
+void relatorio_ocupacao_menu() {
+    printf("Ano do relatorio: ");
+    int ano;
+    if (scanf("%d", &ano) != 1 || ano < 1900 || ano > 9999) { printf("Ano invalido.\n"); limpar_buffer_scanf(); return; }
+    limpar_buffer_scanf();
+    relatorio_ocupacao(ano);
+}
 
-void listar_todos_clientes() {
-    FILE *f = fopen(ARQ_CLIENTES, "rb");
-    if (!f) { printf("Nenhum cliente cadastrado.\n"); return; }
-    Cliente c;
-    while (fread(&c, sizeof(Cliente), 1, f) == 1) {
-        mostrar_cliente(&c); printf("----\n");
+//dados sinteticos e benchmark (--gerar, --benchmark)
+
+#define BENCH_PASTA "benchmark"
+#define BENCH_RESULTADOS "resultados.csv"
+#define BENCH_SEMENTE 20240601u
+#define BENCH_BLOCO 100000
+#define BENCH_GRUPO 64 // comandos por fsync nas medicoes em grupo
+
+const char *bench_nomes[] = { "Ana", "Bruno", "Carla", "Daniel", "Eduarda", "Felipe", "Gabriela", "Heitor",
+    "Isabela", "Joao", "Larissa", "Marcos", "Natalia", "Otavio", "Paula", "Rafael", "Sofia", "Tiago",
+    "Valeria", "Vinicius" };
+const char *bench_sobrenomes[] = { "Silva", "Santos", "Oliveira", "Souza", "Rodrigues", "Ferreira", "Alves",
+    "Pereira", "Lima", "Gomes", "Costa", "Ribeiro", "Martins", "Carvalho", "Almeida", "Lopes", "Soares",
+    "Fernandes", "Vieira", "Barbosa", "Rocha", "Dias", "Nascimento", "Andrade", "Moreira", "Nunes" };
+const char *bench_cargos[] = { "Recepcionista", "Camareira", "Gerente", "Cozinheiro", "Manutencao" };
+#define BENCH_QTD(v) (sizeof(v) / sizeof((v)[0]))
+
+uint32_t bench_estado = BENCH_SEMENTE;
+
+// xorshift32: mesma semente, mesmos arquivos em todo build
+uint32_t bench_aleatorio() {
+    bench_estado ^= bench_estado << 13;
+    bench_estado ^= bench_estado >> 17;
+    bench_estado ^= bench_estado << 5;
+    return bench_estado;
+}
+
+int bench_entre(int a, int b) {
+    return a + (int)(bench_aleatorio() % (uint32_t)(b - a + 1));
+}
+
+long bench_limitar(long v, long minimo, long maximo) {
+    return v < minimo ? minimo : (v > maximo ? maximo : v);
+}
+
+// primeiro dia das estadias geradas e dia seguinte a ultima saida
+Data bench_inicio = 0, bench_fim = 0;
+long bench_qtd_clientes = 0;
+double bench_tempo_geracao = 0;
+
+/* gera clientes, funcionarios, quartos e estadias numa pasta sem .dat.
+   cada quarto tem uma sequencia de estadias sem conflito (1 a 7 diarias,
+   0 a 5 dias de intervalo), distribuidas entre os quartos em rodizio; as
+   3 ultimas de cada quarto ficam ativas, e vai junto um tarifas.txt de
+   exemplo. fidelidade.dat e os .tri sao montados na carga normal. retorna
+   0 se algo nao pode ser gravado */
+int gerar_dados(long estadias) {
+    const char *arquivos[] = { ARQ_CLIENTES, ARQ_FUNCIONARIOS, ARQ_QUARTOS, ARQ_ESTADIAS, ARQ_FIDELIDADE };
+    for (size_t i = 0; i < BENCH_QTD(arquivos); ++i) {
+        FILE *f = fopen(arquivos[i], "rb");
+        if (f) { fclose(f); printf("%s ja existe; gere os dados numa pasta vazia.\n", arquivos[i]); return 0; }
     }
-    fclose(f);
+    double inicio = agora_segundos();
+    bench_estado = BENCH_SEMENTE;
+    long qtd_quartos = bench_limitar(estadias / 2000, 20, 5000);
+    bench_qtd_clientes = bench_limitar(estadias / 4, 100, 2000000);
+    Indice rascunho;
+    memset(&rascunho, 0, sizeof(rascunho));
+    int ok = 1;
+
+    Cliente *cs = malloc(BENCH_BLOCO * sizeof(Cliente));
+    Estadia *es = malloc(BENCH_BLOCO * sizeof(Estadia));
+    Quarto *qs = malloc((size_t)qtd_quartos * sizeof(Quarto));
+    Data *cursor = malloc((size_t)qtd_quartos * sizeof(Data));
+    if (!cs || !es || !qs || !cursor) ok = 0;
+
+    // clientes em blocos, com um indice de rascunho por bloco (a carga monta o de verdade)
+    for (long feitos = 0; ok && feitos < bench_qtd_clientes; ) {
+        size_t n = (size_t)bench_limitar(bench_qtd_clientes - feitos, 0, BENCH_BLOCO);
+        for (size_t i = 0; i < n; ++i) {
+            Cliente *c = &cs[i];
+            memset(c, 0, sizeof(*c));
+            c->codigo = (int32_t)(feitos + (long)i + 1);
+            snprintf(c->nome, sizeof(c->nome), "%s %s %s", bench_nomes[bench_aleatorio() % BENCH_QTD(bench_nomes)],
+                     bench_sobrenomes[bench_aleatorio() % BENCH_QTD(bench_sobrenomes)],
+                     bench_sobrenomes[bench_aleatorio() % BENCH_QTD(bench_sobrenomes)]);
+            snprintf(c->endereco, sizeof(c->endereco), "Rua %s, %d", bench_sobrenomes[bench_aleatorio() % BENCH_QTD(bench_sobrenomes)],
+                     bench_entre(1, 2000));
+            snprintf(c->telefone, sizeof(c->telefone), "(%02d) 9%04d-%04d", bench_entre(11, 99), bench_entre(0, 9999), bench_entre(0, 9999));
+        }
+        ok = anexar_registros(&rascunho, ARQ_CLIENTES, cs, n, sizeof(Cliente));
+        indice_liberar(&rascunho);
+        feitos += (long)n;
+    }
+
+    for (int i = 0; ok && i < 50; ++i) {
+        Funcionario f;
+        memset(&f, 0, sizeof(f));
+        f.codigo = i + 1;
+        snprintf(f.nome, sizeof(f.nome), "%s %s", bench_nomes[bench_aleatorio() % BENCH_QTD(bench_nomes)],
+                 bench_sobrenomes[bench_aleatorio() % BENCH_QTD(bench_sobrenomes)]);
+        snprintf(f.telefone, sizeof(f.telefone), "(%02d) 3%03d-%04d", bench_entre(11, 99), bench_entre(0, 999), bench_entre(0, 9999));
+        copiar_campo(f.cargo, sizeof(f.cargo), bench_cargos[bench_aleatorio() % BENCH_QTD(bench_cargos)]);
+        f.salario = (float)bench_entre(1500, 9000);
+        ok = anexar_registros(&rascunho, ARQ_FUNCIONARIOS, &f, 1, sizeof(Funcionario));
+    }
+    indice_liberar(&rascunho);
+
+    // quartos por andar (101, 102, ...), diaria cresce com a capacidade
+    bench_inicio = data_de_civil(2015, 1, 1);
+    for (long i = 0; ok && i < qtd_quartos; ++i) {
+        Quarto *q = &qs[i];
+        memset(q, 0, sizeof(*q));
+        q->numero = (int32_t)((i / 40 + 1) * 100 + i % 40 + 1);
+        q->qtdHospedes = (int16_t)(bench_entre(1, 10) <= 6 ? bench_entre(1, 2) : bench_entre(3, 6));
+        q->valorDiaria = (float)(80 + 45 * q->qtdHospedes + bench_entre(0, 40));
+        cursor[i] = bench_inicio + bench_entre(0, 30);
+    }
+    if (ok) ok = anexar_registros(&rascunho, ARQ_QUARTOS, qs, (size_t)qtd_quartos, sizeof(Quarto));
+    indice_liberar(&rascunho);
+
+    long ativas_desde = estadias - 3 * qtd_quartos;
+    bench_fim = bench_inicio;
+    for (long feitos = 0; ok && feitos < estadias; ) {
+        size_t n = (size_t)bench_limitar(estadias - feitos, 0, BENCH_BLOCO);
+        for (size_t i = 0; i < n; ++i) {
+            long k = feitos + (long)i, q = k % qtd_quartos;
+            Estadia *e = &es[i];
+            memset(e, 0, sizeof(*e));
+            e->codigo = (int32_t)(k + 1);
+            e->numeroQuarto = qs[q].numero;
+            e->codCliente = bench_entre(1, (int)bench_qtd_clientes);
+            int r = bench_entre(1, 10);
+            e->qtdDiarias = (int16_t)(r <= 5 ? bench_entre(1, 3) : (r <= 9 ? bench_entre(4, 7) : bench_entre(8, 14)));
+            e->dataEntrada = cursor[q] + bench_entre(0, 5);
+            e->dataSaida = e->dataEntrada + e->qtdDiarias;
+            e->ativo = k >= ativas_desde;
+            cursor[q] = e->dataSaida;
+            if (e->dataSaida > bench_fim) bench_fim = e->dataSaida;
+        }
+        ok = anexar_registros(&rascunho, ARQ_ESTADIAS, es, n, sizeof(Estadia));
+        indice_liberar(&rascunho);
+        feitos += (long)n;
+    }
+    free(cs); free(es); free(qs); free(cursor);
+
+    // tarifas de exemplo (um tarifas.txt que ja esteja na pasta fica)
+    FILE *tf = ok ? fopen(ARQ_TARIFAS, "r") : NULL;
+    if (tf) fclose(tf);
+    else if (ok && (tf = fopen(ARQ_TARIFAS, "w")) != NULL) {
+        fprintf(tf, "# gerado por --gerar\ntemporada;15/12;28/02;30\ntemporada;01/07;31/07;15\n"
+                    "dia;sex;10\ndia;sab;15\ndia;dom;-10\nocupacao;70;10\nocupacao;90;25\n");
+        if (fclose(tf) != 0) ok = 0;
+    }
+    bench_tempo_geracao = agora_segundos() - inicio;
+    if (!ok) { printf("Erro ao gravar os dados sinteticos.\n"); return 0; }
+    printf("Gerados %ld clientes, %ld quartos e %ld estadias em %.2f s.\n", bench_qtd_clientes, qtd_quartos,
+           estadias, bench_tempo_geracao);
+    return 1;
 }
 
-void listar_todos_quartos() {
-    FILE *f = fopen(ARQ_QUARTOS, "rb");
-    if (!f) { printf("Nenhum quarto cadastrado.\n"); return; }
-    Quarto q;
-    while (fread(&q, sizeof(Quarto), 1, f) == 1) {
-        printf("Quarto %d | Capacidade: %d | Valor: R$ %.2f | Status: %s\n",
-               q.numero, q.qtdHospedes, q.valorDiaria, q.ocupado ? "ocupado" : "desocupado");
+// apaga os arquivos de uma rodada anterior do benchmark (so os nomes conhecidos)
+void bench_limpar_pasta() {
+    const char *arquivos[] = { ARQ_CLIENTES, ARQ_FUNCIONARIOS, ARQ_QUARTOS, ARQ_ESTADIAS, ARQ_FIDELIDADE,
+        ARQ_DIARIO, ARQ_TRI_CLIENTES, ARQ_TRI_FUNCIONARIOS, ARQ_TARIFAS, ARQ_ALTERACOES, ARQ_SEGUIDOR };
+    char nome[64];
+    for (size_t i = 0; i < BENCH_QTD(arquivos); ++i) {
+        remove(arquivos[i]);
+        snprintf(nome, sizeof(nome), "%s.lck", arquivos[i]);
+        remove(nome);
     }
-    fclose(f);
 }
 
-void listar_todas_estadias() {
-    FILE *f = fopen(ARQ_ESTADIAS, "rb");
-    if (!f) { printf("Nenhuma estadia cadastrada.\n"); return; }
-    Estadia e;
-    while (fread(&e, sizeof(Estadia), 1, f) == 1) {
-        printf("Estadia %d | Cliente %d | Quarto %d | %s -> %s | Diarias: %d | %s\n",
-               e.codigo, e.codCliente, e.numeroQuarto, e.dataEntrada, e.dataSaida, e.qtdDiarias,
-               e.ativo ? "ativa" : "finalizada");
+// cria (se preciso) e entra na pasta do benchmark e gera os dados do zero
+int preparar_benchmark(long estadias, const char *pasta) {
+    if (estadias < 1000) { printf("Escala minima do benchmark: 1000 estadias.\n"); return 0; }
+#ifdef _WIN32
+    _mkdir(pasta);
+    int entrou = _chdir(pasta) == 0;
+#else
+    mkdir(pasta, 0755);
+    int entrou = chdir(pasta) == 0;
+#endif
+    if (!entrou) { perror("Erro ao entrar na pasta do benchmark"); return 0; }
+    bench_limpar_pasta();
+    return gerar_dados(estadias);
+}
+
+FILE *bench_saida = NULL; // resultados.csv, aberto em modo de acrescimo
+
+// uma linha por operacao: na tela e em resultados.csv (historico entre builds)
+void bench_resultado(const char *operacao, long escala, long repeticoes, double segundos) {
+    char quando[32];
+    time_t agora = time(NULL);
+    strftime(quando, sizeof(quando), "%Y-%m-%d %H:%M:%S", localtime(&agora));
+    double us = repeticoes > 0 ? segundos * 1e6 / repeticoes : 0;
+    printf("benchmark;%s;%ld;%ld;%.3f;%.3f\n", operacao, escala, repeticoes, segundos * 1000, us);
+    if (bench_saida)
+        fprintf(bench_saida, "%s;%s;%s;%ld;%ld;%.3f;%.3f\n", quando, __DATE__ " " __TIME__, operacao, escala,
+                repeticoes, segundos * 1000, us);
+}
+
+void bench_contar(const void *reg, long pos, void *ctx) {
+    (void)reg; (void)pos;
+    (*(long *)ctx)++;
+}
+
+// reservas aleatorias; no modo lote cada uma conta como um comando do grupo
+long bench_reservar(long reps, int *codigos, long *erros) {
+    long feitas = 0;
+    for (long i = 0; i < reps; ++i) {
+        Estadia e;
+        memset(&e, 0, sizeof(e));
+        e.codCliente = bench_entre(1, (int)bench_qtd_clientes);
+        e.dataEntrada = bench_fim + bench_entre(0, 365);
+        e.dataSaida = e.dataEntrada + bench_entre(1, 5);
+        if (registrar_estadia(&e, bench_entre(1, 4)) == NULL) codigos[feitas++] = e.codigo;
+        else (*erros)++;
+        if (modo_lote && !lote_comando_feito(0)) (*erros)++;
     }
-    fclose(f);
+    return feitas;
+}
+
+long bench_finalizar(const int *codigos, long n, long *erros) {
+    for (long i = 0; i < n; ++i) {
+        Estadia e;
+        Quarto q;
+        if (finalizar_estadia(codigos[i], &e, &q) != NULL) (*erros)++;
+        if (modo_lote && !lote_comando_feito(0)) (*erros)++;
+    }
+    return n;
+}
+
+// carga: o que o programa faz ao abrir (indices, agendas, alocador, nomes)
+void bench_recarregar() {
+    liberar_alocador();
+    liberar_agendas();
+    texto_liberar(&txt_clientes);
+    texto_liberar(&txt_funcionarios);
+    liberar_indices();
+    indice_liberar(&idx_fidelidade);
+    carregar_indices();
+    carregar_fidelidade();
+    texto_carregar(&txt_clientes);
+    texto_carregar(&txt_funcionarios);
+    carregar_agendas();
+    carregar_alocador();
+    carregar_tarifas();
+}
+
+// relatorio do ano todo: retrato das estadias e uma soma por mes
+long bench_relatorio() {
+    long noites = 0;
+    RetratoEstadias ret;
+    if (retrato_montar(&ret)) {
+        for (int m = 1; m <= 12; ++m)
+            noites += (long)somar_periodo(&ret, NULL, NULL, bench_inicio + (m - 1) * 30, bench_inicio + m * 30).noites;
+        retrato_liberar(&ret);
+    }
+    return noites;
+}
+
+/* mede as operacoes principais sobre os dados gerados por preparar_benchmark
+   (o estado ja foi carregado pelo main). saida: uma linha por operacao
+     benchmark;operacao;escala;repeticoes;total_ms;us_por_op
+   e as mesmas linhas, com data e build, acrescentadas em resultados.csv */
+int executar_benchmark(long estadias) {
+    long reps = bench_limitar(estadias / 100, 100, 2000);
+    FILE *f = fopen(BENCH_RESULTADOS, "rb");
+    int novo = f == NULL;
+    if (f) fclose(f);
+    bench_saida = fopen(BENCH_RESULTADOS, "a");
+    if (bench_saida && novo) fprintf(bench_saida, "quando;build;operacao;escala;repeticoes;total_ms;us_por_op\n");
+    printf("benchmark;operacao;escala;repeticoes;total_ms;us_por_op\n");
+    bench_resultado("gerar", estadias, 1, bench_tempo_geracao);
+
+    double t = agora_segundos();
+    bench_recarregar();
+    bench_resultado("carga", estadias, 1, agora_segundos() - t);
+
+    bench_estado = BENCH_SEMENTE ^ 0x5bd1e995u;
+    int *codigos = malloc((size_t)reps * sizeof(int));
+    if (!codigos) return 0;
+    long feitas, erros = 0;
+    t = agora_segundos();
+    feitas = bench_reservar(reps, codigos, &erros);
+    bench_resultado("reserva", estadias, reps, agora_segundos() - t);
+    t = agora_segundos();
+    feitas = bench_finalizar(codigos, feitas, &erros);
+    bench_resultado("baixa", estadias, feitas, agora_segundos() - t);
+
+    // as mesmas operacoes com commit em grupo (servidor com grupo > 1)
+    modo_lote = 1;
+    grupo_comandos = BENCH_GRUPO;
+    t = agora_segundos();
+    feitas = bench_reservar(reps, codigos, &erros);
+    if (!lote_descarregar()) erros++;
+    bench_resultado("reserva_grupo", estadias, reps, agora_segundos() - t);
+    t = agora_segundos();
+    feitas = bench_finalizar(codigos, feitas, &erros);
+    if (!lote_encerrar()) erros++;
+    bench_resultado("baixa_grupo", estadias, feitas, agora_segundos() - t);
+    grupo_comandos = LOTE_COMANDOS;
+    free(codigos);
+
+    long achados = 0;
+    t = agora_segundos();
+    for (long i = 0; i < reps; ++i) {
+        Cliente c;
+        if (ler_registro(ARQ_CLIENTES, sizeof(Cliente), indice_buscar(&idx_clientes, bench_entre(1, (int)bench_qtd_clientes)), &c))
+            achados++;
+    }
+    bench_resultado("busca_codigo", estadias, reps, agora_segundos() - t);
+
+    t = agora_segundos();
+    for (long i = 0; i < reps; ++i) {
+        char busca[8];
+        const char *sobrenome = bench_sobrenomes[bench_aleatorio() % BENCH_QTD(bench_sobrenomes)];
+        copiar_campo(busca, sizeof(busca), sobrenome + bench_entre(0, 1));
+        texto_buscar(&txt_clientes, busca, bench_contar, &achados);
+    }
+    bench_resultado("busca_nome", estadias, reps, agora_segundos() - t);
+
+    // listagem: formata todas as estadias como a opcao 12, sem mandar para a tela
+    t = agora_segundos();
+    VisaoArquivo v;
+    long listadas = 0;
+    if (abrir_visao(&v, ARQ_ESTADIAS, sizeof(Estadia))) {
+        const Estadia *es = v.registros;
+        char linha[160], ent[9], sai[9];
+        for (size_t i = 0; i < v.quantidade; ++i) {
+            formatar_data(es[i].dataEntrada, ent); formatar_data(es[i].dataSaida, sai);
+            snprintf(linha, sizeof(linha), "Estadia %d | Cliente %d | Quarto %d | %s -> %s | Diarias: %d | %s",
+                     es[i].codigo, es[i].codCliente, es[i].numeroQuarto, ent, sai, es[i].qtdDiarias,
+                     es[i].ativo ? "ativa" : "finalizada");
+            listadas += linha[0] == 'E';
+        }
+        fechar_visao(&v);
+    }
+    bench_resultado("listagem", estadias, listadas, agora_segundos() - t);
+
+    t = agora_segundos();
+    for (long i = 0; i < reps; ++i) {
+        Fidelidade fd;
+        if (ler_registro(ARQ_FIDELIDADE, sizeof(Fidelidade), indice_buscar(&idx_fidelidade, bench_entre(1, (int)bench_qtd_clientes)), &fd))
+            achados += fd.totalDiarias > 0;
+    }
+    bench_resultado("pontos", estadias, reps, agora_segundos() - t);
+
+    t = agora_segundos();
+    for (long i = 0; i < reps; ++i) {
+        size_t n;
+        Data entrada = bench_fim - 30 + bench_entre(0, 60);
+        free(quartos_livres(bench_entre(1, 4), entrada, entrada + bench_entre(1, 7), &n));
+        achados += (long)n;
+    }
+    bench_resultado("disponibilidade", estadias, reps, agora_segundos() - t);
+
+    // cotacao de um quarto: somas de prefixo das tabelas de tarifa (a primeira monta o ano)
+    VisaoArquivo vq;
+    if (abrir_visao(&vq, ARQ_QUARTOS, sizeof(Quarto))) {
+        const Quarto *qs = vq.registros;
+        t = agora_segundos();
+        for (long i = 0; i < reps; ++i) {
+            Centavos total;
+            Data entrada = bench_fim - 30 + bench_entre(0, 60);
+            if (!tarifa_periodo(qs[bench_aleatorio() % vq.quantidade].numero, entrada, entrada + bench_entre(1, 7), &total))
+                erros++;
+        }
+        bench_resultado("cotacao", estadias, reps, agora_segundos() - t);
+        fechar_visao(&vq);
+    }
+
+    t = agora_segundos();
+    long noites = bench_relatorio();
+    bench_resultado("relatorio", estadias, 1, agora_segundos() - t);
+
+    // o mesmo estado com as finalizadas nos arquivos mensais
+    t = agora_segundos();
+    if (!compactar_estadias()) erros++;
+    bench_resultado("compactar", estadias, 1, agora_segundos() - t);
+    t = agora_segundos();
+    bench_recarregar();
+    bench_resultado("carga_compactada", estadias, 1, agora_segundos() - t);
+    t = agora_segundos();
+    if (bench_relatorio() != noites) erros++; // as duas camadas somam o mesmo
+    bench_resultado("relatorio_compactado", estadias, 1, agora_segundos() - t);
+
+    if (bench_saida) fclose(bench_saida);
+    bench_saida = NULL;
+    if (erros) printf("%ld operacoes falharam durante o benchmark.\n", erros);
+    return erros == 0;
+}
+
+//modo servidor (--servidor) e cliente de linha (--conectar)
+
+#define ARQ_SOCKET "hotel.sock"
+#define SERVIDOR_FILA 64
+#define SERVIDOR_MAX_FIOS 16
+#define SERVIDOR_ESPERA_MS 10 // idade maxima do grupo se nao for informada
+
+#ifndef _WIN32
+/* o estado (indices, agendas, alocador, busca por nome) ja e montado uma vez
+   no inicio; no modo servidor ele fica vivo entre os pedidos, que chegam por
+   um socket local, uma linha por pedido:
+     cliente;... quarto;... estadia;... baixa;... funcionario;...  (como no --lote)
+     buscar;cliente|funcionario;texto
+     estadias;codCliente
+     pontos;codCliente
+     livres;hospedes;DD/MM/AAAA;DD/MM/AAAA
+     sincronizar          (descarrega o grupo pendente)
+     sair
+   a resposta e zero ou mais linhas de dados e depois "OK" ou "ERRO msg".
+   um grupo fixo de fios atende as conexoes. consultas rodam juntas (trava
+   de leitura); comandos que gravam passam um de cada vez (trava de escrita),
+   entao so um fio por vez anexa nos .dat, que continuam sendo o registro
+   de tudo. as travas entre processos continuam valendo, entao o menu em
+   outro terminal pode usar os mesmos arquivos ao mesmo tempo.
+   com grupo > 1 o servidor grava em modo lote: um fsync por arquivo a cada
+   grupo comandos ou quando o grupo mais velho passa de espera_ms, o que
+   vier antes. o OK de um comando sem '!' na frente pode chegar antes do
+   fsync; com '!' (ex. "!estadia;...") o OK so sai depois dele. */
+
+typedef struct {
+    int conexoes[SERVIDOR_FILA];
+    size_t inicio, qtd;
+    pthread_mutex_t trava;
+    pthread_cond_t tem_conexao;
+} FilaConexoes;
+
+FilaConexoes fila_conexoes = { {0}, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+pthread_rwlock_t trava_estado = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t trava_tarifas = PTHREAD_MUTEX_INITIALIZER; // consultas de livres montam tabelas de tarifa
+volatile sig_atomic_t servidor_ativo = 1;
+
+void parar_servidor(int sinal) {
+    (void)sinal;
+    servidor_ativo = 0;
+}
+
+// conecta no socket do servidor. retorna o descritor ou -1
+int abrir_conexao(const char *caminho) {
+    struct sockaddr_un end;
+    if (strlen(caminho) >= sizeof(end.sun_path)) return -1;
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) return -1;
+    memset(&end, 0, sizeof(end));
+    end.sun_family = AF_UNIX;
+    strcpy(end.sun_path, caminho);
+    if (connect(s, (struct sockaddr *)&end, sizeof(end)) != 0) { close(s); return -1; }
+    return s;
+}
+
+void enviar_cliente(const void *reg, long pos, void *ctx) {
+    (void)pos;
+    const Cliente *c = reg;
+    fprintf((FILE *)ctx, "cliente;%d;%s;%s;%s\n", c->codigo, c->nome, c->endereco, c->telefone);
+}
+
+void enviar_funcionario(const void *reg, long pos, void *ctx) {
+    (void)pos;
+    const Funcionario *f = reg;
+    fprintf((FILE *)ctx, "funcionario;%d;%s;%s;%s;%.2f\n", f->codigo, f->nome, f->telefone, f->cargo, f->salario);
+}
+
+void enviar_estadia(const Estadia *e, void *ctx) {
+    int da, dm, dd, sa, sm, sd;
+    civil_de_data(e->dataEntrada, &da, &dm, &dd);
+    civil_de_data(e->dataSaida, &sa, &sm, &sd);
+    fprintf((FILE *)ctx, "estadia;%d;%d;%d;%02d/%02d/%04d;%02d/%02d/%04d;%d;%s\n",
+            e->codigo, e->codCliente, e->numeroQuarto, dd, dm, da, sd, sm, sa,
+            e->qtdDiarias, e->ativo ? "ativa" : "finalizada");
+}
+
+/* consultas: as linhas vao para um buffer em memoria e so sao enviadas
+   depois de soltar a trava, para um cliente lento nao segurar quem grava */
+const char *consultar(char **c, size_t n, FILE *saida) {
+    int cod;
+    if (strcmp(c[0], "buscar") == 0) {
+        IndiceTexto *t = NULL;
+        AcaoRegistro acao = NULL;
+        if (n == 3 && strcmp(c[1], "cliente") == 0) { t = &txt_clientes; acao = enviar_cliente; }
+        else if (n == 3 && strcmp(c[1], "funcionario") == 0) { t = &txt_funcionarios; acao = enviar_funcionario; }
+        else return "uso: buscar;cliente|funcionario;texto";
+        texto_buscar(t, c[2], acao, saida);
+        return NULL;
+    }
+    if (strcmp(c[0], "estadias") == 0) {
+        if (n != 2 || !campo_inteiro(c[1], &cod)) return "uso: estadias;codCliente";
+        Indice conjunto;
+        memset(&conjunto, 0, sizeof(conjunto));
+        indice_inserir(&conjunto, cod, 0);
+        juntar_estadias(&conjunto, enviar_estadia, saida);
+        indice_liberar(&conjunto);
+        return NULL;
+    }
+    if (strcmp(c[0], "livres") == 0) {
+        Data entrada, fim;
+        if (n != 4 || !campo_inteiro(c[1], &cod) || !campo_data(c[2], &entrada) || !campo_data(c[3], &fim))
+            return "uso: livres;hospedes;DD/MM/AAAA;DD/MM/AAAA";
+        if (diff_days(entrada, fim) <= 0) return "Periodo invalido (saida deve ser apos entrada).";
+        size_t qtd;
+        pthread_mutex_lock(&trava_tarifas);
+        QuartoLivre *livres = quartos_livres(cod, entrada, fim, &qtd);
+        pthread_mutex_unlock(&trava_tarifas);
+        char diaria[TAM_REAIS], total[TAM_REAIS];
+        for (size_t i = 0; i < qtd; ++i)
+            fprintf(saida, "livre;%d;%d;%s;%s\n", livres[i].numero, livres[i].capacidade,
+                    formatar_centavos(livres[i].diaria, diaria), formatar_centavos(livres[i].total, total));
+        free(livres);
+        return NULL;
+    }
+    if (n != 2 || !campo_inteiro(c[1], &cod)) return "uso: pontos;codCliente";
+    Fidelidade fd;
+    int diarias = 0;
+    if (ler_registro(ARQ_FIDELIDADE, sizeof(Fidelidade), indice_buscar(&idx_fidelidade, cod), &fd))
+        diarias = fd.totalDiarias;
+    fprintf(saida, "pontos;%d;%d;%d\n", cod, diarias, diarias * PONTOS_POR_DIARIA);
+    return NULL;
+}
+
+const char *atender_pedido(char **c, size_t n, FILE *out) {
+    if (strcmp(c[0], "buscar") == 0 || strcmp(c[0], "estadias") == 0 || strcmp(c[0], "pontos") == 0 ||
+        strcmp(c[0], "livres") == 0) {
+        char *dados = NULL;
+        size_t tam = 0;
+        FILE *saida = open_memstream(&dados, &tam);
+        if (!saida) return "sem memoria";
+        pthread_rwlock_rdlock(&trava_estado);
+        double t = agora_segundos();
+        const char *erro = consultar(c, n, saida);
+        if (!erro) medir(MED_CONSULTA, t);
+        pthread_rwlock_unlock(&trava_estado);
+        fclose(saida);
+        fwrite(dados, 1, tam, out);
+        free(dados);
+        return erro;
+    }
+    char resposta[128] = "";
+    int duravel = c[0][0] == '!';
+    if (duravel) c[0]++;
+    int sincronizar = n == 1 && strcmp(c[0], "sincronizar") == 0;
+    pthread_rwlock_wrlock(&trava_estado);
+    double t = agora_segundos();
+    const char *erro = sincronizar ? NULL : executar_comando(c, n, resposta, sizeof(resposta));
+    if (!erro) medir(MED_COMANDO, t);
+    if (modo_lote && !lote_comando_feito(duravel || sincronizar) && !erro)
+        erro = "erro ao descarregar os arquivos";
+    pthread_rwlock_unlock(&trava_estado);
+    if (!erro && resposta[0]) fprintf(out, "%s\n", resposta);
+    return erro;
+}
+
+void atender_conexao(int s) {
+    int s2 = dup(s);
+    FILE *in = fdopen(s, "r");
+    FILE *out = s2 >= 0 ? fdopen(s2, "w") : NULL;
+    if (!in || !out) {
+        if (in) fclose(in); else close(s);
+        if (out) fclose(out); else if (s2 >= 0) close(s2);
+        return;
+    }
+    char linha[512];
+    while (fgets(linha, sizeof(linha), in)) {
+        char *campos[LOTE_MAX_CAMPOS];
+        size_t n = separar_campos(linha, campos, LOTE_MAX_CAMPOS);
+        if (campos[0][0] == '\0' || campos[0][0] == '#') continue;
+        if (strcmp(campos[0], "sair") == 0) break;
+        const char *erro = atender_pedido(campos, n, out);
+        if (erro) fprintf(out, "ERRO %s\n", erro);
+        else fprintf(out, "OK\n");
+        if (fflush(out) != 0) break;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+// fio do grupo: atende uma conexao inteira por vez, para sempre
+FIO_RETORNO atender_conexoes(void *arg) {
+    (void)arg;
+    FilaConexoes *f = &fila_conexoes;
+    for (;;) {
+        pthread_mutex_lock(&f->trava);
+        while (f->qtd == 0) pthread_cond_wait(&f->tem_conexao, &f->trava);
+        int s = f->conexoes[f->inicio];
+        f->inicio = (f->inicio + 1) % SERVIDOR_FILA;
+        f->qtd--;
+        pthread_mutex_unlock(&f->trava);
+        atender_conexao(s);
+    }
+    return 0;
+}
+
+// descarrega o grupo que passou de grupo_espera_ms sem encher
+FIO_RETORNO descarregar_por_tempo(void *arg) {
+    (void)arg;
+    int passo = grupo_espera_ms > 1 ? grupo_espera_ms / 2 : 1;
+    struct timespec pausa = { passo / 1000, (passo % 1000) * 1000000L };
+    for (;;) {
+        nanosleep(&pausa, NULL);
+        // quem tem a trava de leitura ve os contadores sem ninguem gravando
+        pthread_rwlock_rdlock(&trava_estado);
+        int vencido = lote_grupo_vencido();
+        pthread_rwlock_unlock(&trava_estado);
+        if (!vencido) continue;
+        pthread_rwlock_wrlock(&trava_estado);
+        if (lote_grupo_vencido() && !lote_descarregar()) printf("Erro ao descarregar os arquivos.\n");
+        pthread_rwlock_unlock(&trava_estado);
+    }
+    return 0;
+}
+
+/* roda ate SIGINT/SIGTERM. grupo > 1 liga o commit em grupo (espera_ms 0 =
+   so pelo tamanho do grupo). retorna 0 se o socket nao pode ser aberto */
+int servidor(const char *caminho, int grupo, int espera_ms) {
+    struct sockaddr_un end;
+    if (strlen(caminho) >= sizeof(end.sun_path)) { printf("Caminho do socket muito longo.\n"); return 0; }
+    int ja = abrir_conexao(caminho);
+    if (ja >= 0) { close(ja); printf("Ja existe um servidor em %s.\n", caminho); return 0; }
+    unlink(caminho); // sobra de uma execucao que nao terminou direito
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&end, 0, sizeof(end));
+    end.sun_family = AF_UNIX;
+    strcpy(end.sun_path, caminho);
+    if (s < 0 || bind(s, (struct sockaddr *)&end, sizeof(end)) != 0 || listen(s, SERVIDOR_FILA) != 0) {
+        perror("Erro ao abrir o socket");
+        if (s >= 0) close(s);
+        return 0;
+    }
+
+    // sem SA_RESTART: o sinal interrompe o accept. so o fio principal recebe
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = parar_servidor;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = pedir_estatisticas;
+    sigaction(SIGUSR1, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t sinais, antes;
+    sigemptyset(&sinais);
+    sigaddset(&sinais, SIGINT);
+    sigaddset(&sinais, SIGTERM);
+    sigaddset(&sinais, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sinais, &antes);
+    int nfios = numero_de_nucleos();
+    if (nfios < 2) nfios = 2;
+    if (nfios > SERVIDOR_MAX_FIOS) nfios = SERVIDOR_MAX_FIOS;
+    int iniciados = 0;
+    for (int i = 0; i < nfios; ++i) {
+        Fio fio;
+        if (iniciar_fio(&fio, atender_conexoes, NULL)) { pthread_detach(fio); iniciados++; }
+    }
+    if (grupo > 1) {
+        modo_lote = 1;
+        grupo_comandos = grupo;
+        grupo_espera_ms = espera_ms;
+        Fio fio;
+        if (espera_ms > 0 && iniciar_fio(&fio, descarregar_por_tempo, NULL)) pthread_detach(fio);
+    }
+    pthread_sigmask(SIG_SETMASK, &antes, NULL);
+    if (iniciados == 0) { printf("Erro ao iniciar os fios do servidor.\n"); close(s); unlink(caminho); return 0; }
+    printf("Servidor em %s com %d fios (Ctrl+C encerra).\n", caminho, iniciados);
+    if (modo_lote) printf("Commit em grupo: %d comandos ou %d ms.\n", grupo_comandos, grupo_espera_ms);
+    fflush(stdout);
+
+    FilaConexoes *f = &fila_conexoes;
+    while (servidor_ativo) {
+        int c = accept(s, NULL, NULL);
+        if (c < 0) {
+            if (errno == EINTR) {
+                // estatisticas pedidas por sinal: grava sem ninguem gravando junto
+                if (pedido_estatisticas) {
+                    pthread_rwlock_wrlock(&trava_estado);
+                    atender_pedido_estatisticas();
+                    pthread_rwlock_unlock(&trava_estado);
+                }
+                continue;
+            }
+            perror("Erro no accept");
+            break;
+        }
+        pthread_mutex_lock(&f->trava);
+        if (f->qtd == SERVIDOR_FILA) {
+            pthread_mutex_unlock(&f->trava);
+            const char *ocupado = "ERRO servidor ocupado\n";
+            if (write(c, ocupado, strlen(ocupado)) < 0) {}
+            close(c);
+            continue;
+        }
+        f->conexoes[(f->inicio + f->qtd) % SERVIDOR_FILA] = c;
+        f->qtd++;
+        pthread_cond_signal(&f->tem_conexao);
+        pthread_mutex_unlock(&f->trava);
+    }
+    close(s);
+    unlink(caminho);
+    // espera o comando que esta gravando e nao solta mais: os fios morrem com o processo
+    pthread_rwlock_wrlock(&trava_estado);
+    if (modo_lote && !lote_encerrar()) printf("Erro ao descarregar os arquivos.\n");
+    printf("Servidor encerrado.\n");
+    return 1;
+}
+
+/* cliente de linha: manda cada linha da entrada padrao e mostra a resposta
+   ate o OK/ERRO. retorna 1 se todos os pedidos deram certo */
+int conectar_servidor(const char *caminho) {
+    int s = abrir_conexao(caminho);
+    if (s < 0) { printf("Nenhum servidor em %s.\n", caminho); return 0; }
+    FILE *in = fdopen(s, "r");
+    FILE *out = fdopen(dup(s), "w");
+    if (!in || !out) { perror("Erro na conexao"); return 0; }
+    int ok = 1;
+    char linha[512], resposta[1024];
+    while (fgets(linha, sizeof(linha), stdin)) {
+        fputs(linha, out);
+        if (strchr(linha, '\n') == NULL) fputc('\n', out);
+        if (fflush(out) != 0) { ok = 0; break; }
+        char *campos[LOTE_MAX_CAMPOS];
+        size_t n = separar_campos(linha, campos, LOTE_MAX_CAMPOS);
+        if (campos[0][0] == '\0' || campos[0][0] == '#') continue;
+        if (n == 1 && strcmp(campos[0], "sair") == 0) break;
+        int fim = 0;
+        while (!fim && fgets(resposta, sizeof(resposta), in)) {
+            fputs(resposta, stdout);
+            if (strcmp(resposta, "OK\n") == 0) fim = 1;
+            else if (strncmp(resposta, "ERRO ", 5) == 0) { fim = 1; ok = 0; }
+        }
+        if (!fim) { printf("Conexao encerrada pelo servidor.\n"); ok = 0; break; }
+    }
+    fclose(in);
+    fclose(out);
+    return ok;
+}
+#else
+int servidor(const char *caminho, int grupo, int espera_ms) {
+    (void)caminho; (void)grupo; (void)espera_ms;
+    printf("Modo servidor disponivel so em sistemas POSIX.\n");
+    return 0;
+}
+
+int conectar_servidor(const char *caminho) {
+    (void)caminho;
+    printf("Modo servidor disponivel so em sistemas POSIX.\n");
+    return 0;
 }
+#endif
 
 //menu e main
 
@@ -597,35 +6039,112 @@ void menu() {
     printf("10 - Listar todos clientes\n");
     printf("11 - Listar todos quartos\n");
     printf("12 - Listar todas estadias\n");
+    printf("13 - Politica de alocacao de quartos\n");
+    printf("14 - Ranking de clientes mais fieis\n");
+    printf("15 - Relatorio de ocupacao e receita\n");
+    printf("16 - Consultar quartos disponiveis\n");
+    printf("17 - Calendario de ocupacao do mes\n");
+    printf("18 - Estatisticas de desempenho\n");
+    printf("19 - Arquivar estadias finalizadas\n");
+    printf("20 - Cotar estadia (tarifas)\n");
     printf("0 - Sair\n");
     printf("Escolha: ");
 }
 
-int main(void) {
-    int opc;
-    do {
-        menu();
-        if (scanf("%d", &opc) != 1) {
-            limpar_buffer_scanf(); // Limpa buffer em caso de erro no menu
-            printf("Entrada invalida. Saindo.\n"); break;
-        }
-
-        switch (opc) {
-            case 1: cadastrar_cliente(); break;
-            case 2: cadastrar_funcionario(); break;
-            case 3: cadastrar_quarto(); break;
-            case 4: cadastrar_estadia(); break;
-            case 5: dar_baixa_estadia(); break;
-            case 6: pesquisar_cliente(); break;
-            case 7: pesquisar_funcionario(); break;
-            case 8: listar_estadias_cliente(); break;
-            case 9: calcular_pontos(); break;
-            case 10: listar_todos_clientes(); break;
-            case 11: listar_todos_quartos(); break;
-            case 12: listar_todas_estadias(); break;
-            case 0: printf("Tchau! Saindo...\n"); break;
-            default: printf("Opcao invalida.\n"); break;
-        }
-    } while (opc != 0);
-    return 0;
+int main(int argc, char *argv[]) {
+    int opc = 0, status = 0;
+    // cliente do servidor: nao toca nos arquivos
+    if (argc > 1 && strcmp(argv[1], "--conectar") == 0)
+        return conectar_servidor(argc > 2 ? argv[2] : ARQ_SOCKET) ? 0 : 1;
+#ifndef _WIN32
+    signal(SIGUSR1, pedir_estatisticas);
+#endif
+    if (argc > 2 && strcmp(argv[1], "--gerar") == 0)
+        return gerar_dados(atol(argv[2])) ? 0 : 1;
+    if (argc > 2 && strcmp(argv[1], "--benchmark") == 0 &&
+        !preparar_benchmark(atol(argv[2]), argc > 3 ? argv[3] : BENCH_PASTA)) return 1;
+    recuperar_diario();
+    converter_arquivos();
+    if (argc > 1 && strcmp(argv[1], "--converter") == 0) return 0; // so conversao
+    carregar_indices();
+    carregar_fidelidade();
+    if (argc > 1 && strcmp(argv[1], "--verificar-pontos") == 0) {
+        long divergentes = verificar_fidelidade();
+        if (divergentes == 0) printf("Pontos de fidelidade conferem com %s.\n", ARQ_ESTADIAS);
+        else printf("%ld clientes com pontos divergentes; %s refeito.\n", divergentes, ARQ_FIDELIDADE);
+        liberar_indices();
+        indice_liberar(&idx_fidelidade);
+        return 0;
+    }
+    texto_carregar(&txt_clientes);
+    texto_carregar(&txt_funcionarios);
+    carregar_agendas();
+    carregar_alocador();
+    carregar_tarifas();
+    if (argc > 2 && strcmp(argv[1], "--lote") == 0) {
+        if (argc > 3 && atoi(argv[3]) > 0) grupo_comandos = atoi(argv[3]);
+        status = executar_lote(argv[2]) ? 0 : 1;
+    } else if (argc > 3 && strcmp(argv[1], "--importar") == 0) {
+        status = importar_csv(argv[2], argv[3]) ? 0 : 1;
+    } else if (argc > 2 && strcmp(argv[1], "--benchmark") == 0) {
+        status = executar_benchmark(atol(argv[2])) ? 0 : 1;
+    } else if (argc > 1 && strcmp(argv[1], "--publicar") == 0) {
+        status = publicar_pasta() ? 0 : 1;
+    } else if (argc > 2 && strcmp(argv[1], "--seguir") == 0) {
+        status = seguir_origem(argv[2], argc > 3 ? atoi(argv[3]) : SEGUIR_ESPERA_MS) ? 0 : 1;
+    } else if (argc > 1 && strcmp(argv[1], "--compactar") == 0) {
+        status = compactar_estadias() ? 0 : 1;
+    } else if (argc > 2 && strcmp(argv[1], "--relatorio") == 0) {
+        status = relatorio_ocupacao(atoi(argv[2])) ? 0 : 1;
+    } else if (argc > 1 && strcmp(argv[1], "--servidor") == 0) {
+        status = servidor(argc > 2 ? argv[2] : ARQ_SOCKET, argc > 3 ? atoi(argv[3]) : 1,
+                          argc > 4 ? atoi(argv[4]) : SERVIDOR_ESPERA_MS) ? 0 : 1;
+    } else {
+        do {
+            menu();
+            if (scanf("%d", &opc) != 1) {
+                limpar_buffer_scanf(); // Limpa buffer em caso de erro no menu
+                printf("Entrada invalida. Saindo.\n"); break;
+            }
+
+            atender_pedido_estatisticas();
+            double t = agora_segundos();
+            switch (opc) {
+                case 1: cadastrar_cliente(); break;
+                case 2: cadastrar_funcionario(); break;
+                case 3: cadastrar_quarto(); break;
+                case 4: cadastrar_estadia(); break;
+                case 5: dar_baixa_estadia(); break;
+                case 6: pesquisar_cliente(); break;
+                case 7: pesquisar_funcionario(); break;
+                case 8: listar_estadias_cliente(); break;
+                case 9: calcular_pontos(); break;
+                case 10: listar_todos_clientes(); break;
+                case 11: listar_todos_quartos(); break;
+                case 12: listar_todas_estadias(); break;
+                case 13: configurar_alocacao(); break;
+                case 14: listar_mais_fieis(); break;
+                case 15: relatorio_ocupacao_menu(); break;
+                case 16: consultar_disponibilidade(); break;
+                case 17: mostrar_calendario_menu(); break;
+                case 18: mostrar_estatisticas(); break;
+                case 19: compactar_estadias(); break;
+                case 20: cotar_estadia(); break;
+                case 0: printf("Tchau! Saindo...\n"); break;
+                default: printf("Opcao invalida.\n"); break;
+            }
+            if (opc > 0 && opc <= 20) medir((Medicao)(MED_MENU + opc), t);
+        } while (opc != 0);
+    }
+    liberar_alocador();
+    liberar_agendas();
+    liberar_tarifas();
+    if (!texto_salvar(&txt_clientes) || !texto_salvar(&txt_funcionarios))
+        printf("Aviso: nao foi possivel gravar o indice de nomes.\n");
+    texto_liberar(&txt_clientes);
+    texto_liberar(&txt_funcionarios);
+    liberar_indices();
+    indice_liberar(&idx_fidelidade);
+    if (!salvar_estatisticas()) printf("Aviso: nao foi possivel gravar %s.\n", ARQ_ESTATISTICAS);
+    return status;
 }